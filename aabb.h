@@ -0,0 +1,61 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "glm/glm.hpp"
+#include "ray.h"
+
+struct AABB {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+    AABB() = default;
+
+    // Corners may come in any order (setUp passes them that way for most cubes)
+    AABB(const glm::vec3& a, const glm::vec3& b) : min(glm::min(a, b)), max(glm::max(a, b)) {}
+
+    void expand(const AABB& other) {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    void expand(const glm::vec3& p) {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+
+    glm::vec3 centroid() const {
+        return (min + max) * 0.5f;
+    }
+
+    float surfaceArea() const {
+        glm::vec3 d = max - min;
+        if (d.x < 0 || d.y < 0 || d.z < 0) {
+            return 0.0f;
+        }
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    // Slab test against a precomputed inverse direction. Accepts the box when the
+    // ray overlaps it between max(tMin, 0) and tMax; the interval is padded slightly
+    // so that boxes sharing a face with their objects are never rejected by rounding.
+    bool rayIntersect(const glm::vec3& rayOrigin, const glm::vec3& invDirection, float tMax, float tMin = 0.0f) const {
+        glm::vec3 t0 = (min - rayOrigin) * invDirection;
+        glm::vec3 t1 = (max - rayOrigin) * invDirection;
+
+        glm::vec3 tSmall = glm::min(t0, t1);
+        glm::vec3 tBig = glm::max(t0, t1);
+
+        float tNear = glm::max(glm::max(tSmall.x, tSmall.y), tSmall.z);
+        float tFar = glm::min(glm::min(tBig.x, tBig.y), tBig.z);
+        tNear -= std::abs(tNear) * 1e-5f;
+        tFar += std::abs(tFar) * 1e-5f;
+
+        return tNear <= tFar && tFar >= tMin && tNear <= tMax;
+    }
+
+    bool rayIntersect(const Ray& ray) const {
+        return rayIntersect(ray.origin, ray.invDirection, ray.tMax, std::max(ray.tMin, 0.0f));
+    }
+};
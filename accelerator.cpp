@@ -0,0 +1,24 @@
+#include "accelerator.h"
+#include "bvh.h"
+#include "grid.h"
+#include "octree.h"
+#include "widebvh.h"
+
+Accelerator* createAccelerator(const std::string& name) {
+    if (name == "bvh") {
+        return new BVH();
+    }
+    if (name == "bvh4") {
+        return new WideBVH<4>();
+    }
+    if (name == "bvh8") {
+        return new WideBVH<8>();
+    }
+    if (name == "grid") {
+        return new UniformGrid();
+    }
+    if (name == "svo") {
+        return new SparseVoxelOctree();
+    }
+    return nullptr;
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+#include "glm/glm.hpp"
+#include "intersect.h"
+#include "object.h"
+#include "ray.h"
+#include "renderpool.h"
+#include "stats.h"
+
+// Up to MAX_SIZE rays traced together by Accelerator::rayIntersectPacket, which
+// fills in the closest hit of each one
+struct RayPacket {
+    static const int MAX_SIZE = 16;
+
+    int size = 0;
+    glm::vec3 origins[MAX_SIZE];
+    glm::vec3 directions[MAX_SIZE];
+    Intersect intersects[MAX_SIZE];
+    Object* objects[MAX_SIZE];
+
+    void add(const glm::vec3& origin, const glm::vec3& direction) {
+        origins[size] = origin;
+        directions[size] = direction;
+        size++;
+    }
+};
+
+// Spatial index over the scene objects, selected at startup with --accel
+class Accelerator {
+public:
+    virtual ~Accelerator() = default;
+
+    virtual void build(const std::vector<Object*>& sceneObjects) = 0;
+
+    // Closest hit in (ray.tMin, ray.tMax], skipping `ignore`, a part of the
+    // `ignoreOwner` instance when that is set. The default tMin of Ray keeps the
+    // behaviour of Object::rayIntersect, which reports rays starting inside a cube.
+    virtual Intersect rayIntersect(const Ray& ray, Object*& hitObject, const Object* ignore = nullptr,
+                                   const Object* ignoreOwner = nullptr) const = 0;
+
+    // Same results as rayIntersect with the default interval for every ray of
+    // the packet. Traces them one at a time unless overridden.
+    virtual void rayIntersectPacket(RayPacket& packet) const {
+        for (int i = 0; i < packet.size; i++) {
+            packet.intersects[i] = rayIntersect(Ray(packet.origins[i], packet.directions[i]), packet.objects[i]);
+        }
+    }
+
+    // Whether any object other than `ignore` (of `ignoreOwner`, as above) is hit
+    // at a distance in (ray.tMin, ray.tMax). Stops at the first one found,
+    // returned in `occluder`, instead of looking for the nearest.
+    virtual bool occluded(const Ray& ray, const Object*& occluder, const Object* ignore = nullptr,
+                          const Object* ignoreOwner = nullptr) const = 0;
+
+    // Bytes held by the structure itself, not counting the objects
+    virtual size_t getMemoryUsage() const = 0;
+
+    virtual std::string getName() const = 0;
+
+    // Brings the structure up to date after objects moved (Cube::setCorners,
+    // Sphere::setCenter, Instance::setTransform), on the threads of `pool` where
+    // the structure can split the work. Rebuilds unless overridden.
+    virtual void refit(RenderPool& pool) {
+        build(objects);
+    }
+
+protected:
+    std::vector<Object*> objects;
+};
+
+// Leaf test shared by the accelerators: keeps the nearest accepted hit and
+// resolves ties in scene order, so every structure returns the same object.
+// Each accepted hit becomes the new ray.tMax, which the traversal reads to cull
+// nodes and the candidates read to give up early. Candidates only report
+// distances; finalize() computes the point and normal of the winner once the
+// traversal is over.
+struct ClosestHit {
+    Ray ray;
+    const Object* ignore;
+    const Object* ignoreOwner = nullptr;    // the instance `ignore` is a part of, if any
+
+    Hit hit;
+    Object* object = nullptr;
+    const Object* owner = nullptr;  // the instance `object` is a part of, if any
+    uint32_t index = std::numeric_limits<uint32_t>::max();
+
+    void test(Object* candidate, uint32_t candidateIndex) {
+        if (candidate == ignore) {
+            return;
+        }
+        if (candidate->hasParts) {
+            Object* part;
+            Hit h = objectKind(candidate).hitParts(*candidate, ray, part, candidate == ignoreOwner ? ignore : nullptr);
+            record(part, candidateIndex, h, candidate);
+            return;
+        }
+        stats.objectTests++;
+        record(candidate, candidateIndex, objectKind(candidate).hit(*candidate, ray));
+    }
+
+    // Offers a hit computed by the caller, e.g. a voxel entered by grid traversal
+    void record(Object* candidate, uint32_t candidateIndex, const Hit& h, const Object* candidateOwner = nullptr) {
+        if (h.isIntersecting && h.dist > ray.tMin &&
+            (h.dist < ray.tMax || (h.dist == ray.tMax && candidateIndex < index))) {
+            ray.tMax = h.dist;
+            hit = h;
+            object = candidate;
+            owner = candidateOwner;
+            index = candidateIndex;
+        }
+    }
+
+    // Point, normal and uv of the closest hit, or no intersection
+    Intersect finalize() const {
+        if (!object) {
+            return Intersect{};
+        }
+        if (owner) {
+            Intersect intersect = objectKind(owner).finalizeParts(*owner, ray, object, hit);
+            intersect.owner = owner;
+            return intersect;
+        }
+        return objectKind(object).finalize(*object, ray, hit);
+    }
+};
+
+// Leaf test of occlusion queries, any accepted hit ends the query
+struct AnyHit {
+    Ray ray;
+    const Object* ignore;
+    const Object* ignoreOwner = nullptr;
+
+    const Object* occluder = nullptr;
+
+    bool test(const Object* candidate) {
+        if (candidate == ignore) {
+            return false;
+        }
+        bool hit;
+        if (candidate->hasParts) {
+            hit = objectKind(candidate).occludedParts(*candidate, ray, candidate == ignoreOwner ? ignore : nullptr);
+        } else {
+            stats.shadowTests++;
+            hit = objectKind(candidate).occluded(*candidate, ray);
+        }
+        if (hit) {
+            occluder = candidate;
+        }
+        return hit;
+    }
+};
+
+Accelerator* createAccelerator(const std::string& name);
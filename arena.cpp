@@ -0,0 +1,41 @@
+#include "arena.h"
+
+SceneArena::~SceneArena() {
+    for (char* block : blocks) {
+        ::operator delete(block, std::align_val_t(CACHE_LINE));
+    }
+}
+
+void SceneArena::clear() {
+    current = 0;
+    offset = 0;
+    used = 0;
+    objectCount = 0;
+}
+
+void* SceneArena::allocate(size_t size, size_t alignment) {
+    size_t start = (offset + alignment - 1) / alignment * alignment;
+
+    // Start a new cache line rather than straddling one
+    size_t line = start % CACHE_LINE;
+    if (size <= CACHE_LINE && line + size > CACHE_LINE) {
+        start += CACHE_LINE - line;
+    }
+
+    if (blocks.empty() || start + size > BLOCK_SIZE) {
+        if (!blocks.empty()) {
+            // The unused end of the block is counted as used
+            used += BLOCK_SIZE - offset;
+            current++;
+        }
+        if (current == blocks.size()) {
+            blocks.push_back(static_cast<char*>(::operator new(BLOCK_SIZE, std::align_val_t(CACHE_LINE))));
+        }
+        offset = 0;
+        start = 0;
+    }
+
+    used += start + size - offset;
+    offset = start + size;
+    return blocks[current] + start;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Owns the objects of a scene in 64 KB blocks, laid out one after the other in
+// creation order instead of wherever the heap puts them. A record that fits in a
+// cache line never straddles two, so testing a cube or a sphere reads one line.
+//
+// Objects are never freed one by one: clear() forgets all of them at once,
+// without running destructors, and keeps the blocks for the next scene. Only
+// types with nothing to release are created here (primitives and instances, not
+// prefabs, which own their BVH); create() refuses the others at compile time.
+class SceneArena {
+public:
+    static const size_t BLOCK_SIZE = 64 * 1024;
+    static const size_t CACHE_LINE = 64;
+
+    SceneArena() = default;
+    SceneArena(const SceneArena&) = delete;
+    SceneArena& operator=(const SceneArena&) = delete;
+    ~SceneArena();
+
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        static_assert(std::is_trivially_destructible_v<T>, "clear() does not run destructors");
+        objectCount++;
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // Drops every object in O(1); pointers to them are no longer valid
+    void clear();
+
+    size_t getObjectCount() const {
+        return objectCount;
+    }
+
+    // Bytes taken by the objects, padding included
+    size_t getMemoryUsage() const {
+        return used;
+    }
+
+private:
+    void* allocate(size_t size, size_t alignment);
+
+    std::vector<char*> blocks;
+    size_t current = 0;     // block being filled
+    size_t offset = 0;      // first free byte in it
+    size_t used = 0;
+    size_t objectCount = 0;
+};
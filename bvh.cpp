@@ -0,0 +1,522 @@
+#include "bvh.h"
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <memory>
+#include <thread>
+#include <utility>
+#include "stats.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define BVH_SSE
+#endif
+
+namespace {
+
+const int BIN_COUNT = 16;
+const size_t MAX_LEAF_SIZE = 4;
+const int MAX_DEPTH = 60;
+const size_t PARALLEL_THRESHOLD = 1024;
+const float TRAVERSAL_COST = 1.0f;
+const float INTERSECTION_COST = 1.0f;
+
+struct BuildPrimitive {
+    AABB bounds;
+    glm::vec3 centroid;
+    uint32_t index;
+};
+
+struct BuildNode {
+    AABB bounds;
+    std::unique_ptr<BuildNode> children[2];
+    uint32_t first = 0;
+    uint32_t count = 0;
+    uint8_t axis = 0;
+    uint32_t nodeCount = 1;
+};
+
+struct SplitCandidate {
+    int axis = -1;
+    int bin = -1;
+    float cost = std::numeric_limits<float>::max();
+};
+
+int hardwareThreads() {
+    static const int count = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    return count;
+}
+
+int binIndex(const BuildPrimitive& prim, int axis, float minCentroid, float scale) {
+    int bin = static_cast<int>((prim.centroid[axis] - minCentroid) * scale);
+    return std::clamp(bin, 0, BIN_COUNT - 1);
+}
+
+// Evaluates the SAH at every bin boundary of the three axes
+SplitCandidate findSplit(const std::vector<BuildPrimitive>& prims, size_t begin, size_t end, const AABB& centroidBounds) {
+    SplitCandidate best;
+
+    for (int axis = 0; axis < 3; axis++) {
+        float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+        if (extent <= 0.0f) {
+            continue;
+        }
+        float scale = BIN_COUNT / extent;
+
+        AABB binBounds[BIN_COUNT];
+        size_t binCount[BIN_COUNT] = {};
+        for (size_t i = begin; i < end; i++) {
+            int bin = binIndex(prims[i], axis, centroidBounds.min[axis], scale);
+            binBounds[bin].expand(prims[i].bounds);
+            binCount[bin]++;
+        }
+
+        float rightArea[BIN_COUNT];
+        size_t rightCount[BIN_COUNT];
+        AABB accumulated;
+        size_t count = 0;
+        for (int bin = BIN_COUNT - 1; bin > 0; bin--) {
+            accumulated.expand(binBounds[bin]);
+            count += binCount[bin];
+            rightArea[bin] = accumulated.surfaceArea();
+            rightCount[bin] = count;
+        }
+
+        accumulated = AABB();
+        count = 0;
+        for (int bin = 0; bin < BIN_COUNT - 1; bin++) {
+            accumulated.expand(binBounds[bin]);
+            count += binCount[bin];
+            if (count == 0 || rightCount[bin + 1] == 0) {
+                continue;
+            }
+            float cost = count * accumulated.surfaceArea() + rightCount[bin + 1] * rightArea[bin + 1];
+            if (cost < best.cost) {
+                best = {axis, bin, cost};
+            }
+        }
+    }
+
+    return best;
+}
+
+std::unique_ptr<BuildNode> buildRecursive(std::vector<BuildPrimitive>& prims, size_t begin, size_t end, int depth) {
+    auto node = std::make_unique<BuildNode>();
+
+    AABB centroidBounds;
+    for (size_t i = begin; i < end; i++) {
+        node->bounds.expand(prims[i].bounds);
+        centroidBounds.expand(prims[i].centroid);
+    }
+
+    size_t count = end - begin;
+    node->first = static_cast<uint32_t>(begin);
+    node->count = static_cast<uint32_t>(count);
+    if (count <= 1 || depth >= MAX_DEPTH) {
+        return node;
+    }
+
+    SplitCandidate split = findSplit(prims, begin, end, centroidBounds);
+    size_t middle;
+
+    if (split.axis < 0) {
+        // All centroids coincide: keep small sets together, halve big ones
+        if (count <= MAX_LEAF_SIZE) {
+            return node;
+        }
+        middle = begin + count / 2;
+        node->axis = 0;
+    } else {
+        float parentArea = node->bounds.surfaceArea();
+        float splitCost = TRAVERSAL_COST + INTERSECTION_COST * split.cost / std::max(parentArea, 1e-12f);
+        float leafCost = INTERSECTION_COST * count;
+        if (count <= MAX_LEAF_SIZE && leafCost <= splitCost) {
+            return node;
+        }
+
+        float minCentroid = centroidBounds.min[split.axis];
+        float scale = BIN_COUNT / (centroidBounds.max[split.axis] - minCentroid);
+        auto it = std::partition(prims.begin() + begin, prims.begin() + end, [&](const BuildPrimitive& prim) {
+            return binIndex(prim, split.axis, minCentroid, scale) <= split.bin;
+        });
+        middle = it - prims.begin();
+        node->axis = static_cast<uint8_t>(split.axis);
+    }
+
+    node->count = 0;
+
+    // The two halves touch disjoint ranges of prims, so big subtrees build concurrently
+    if (count > PARALLEL_THRESHOLD && (1 << depth) < hardwareThreads()) {
+        auto left = std::async(std::launch::async, buildRecursive, std::ref(prims), begin, middle, depth + 1);
+        node->children[1] = buildRecursive(prims, middle, end, depth + 1);
+        node->children[0] = left.get();
+    } else {
+        node->children[0] = buildRecursive(prims, begin, middle, depth + 1);
+        node->children[1] = buildRecursive(prims, middle, end, depth + 1);
+    }
+    node->nodeCount = 1 + node->children[0]->nodeCount + node->children[1]->nodeCount;
+
+    return node;
+}
+
+uint32_t flatten(const BuildNode* buildNode, std::vector<BVH::Node>& nodes) {
+    uint32_t index = static_cast<uint32_t>(nodes.size());
+    nodes.push_back({buildNode->bounds, buildNode->first, static_cast<uint16_t>(buildNode->count), buildNode->axis});
+
+    if (buildNode->count == 0) {
+        flatten(buildNode->children[0].get(), nodes);
+        nodes[index].offset = flatten(buildNode->children[1].get(), nodes);
+    }
+    return index;
+}
+
+// Refits the subtree stored depth-first in nodes[index, end): the first child is
+// at index + 1 and its subtree ends where the second child starts
+void refitRecursive(std::vector<BVH::Node>& nodes, const std::vector<uint32_t>& indices,
+                    const std::vector<Object*>& objects, uint32_t index, uint32_t end) {
+    BVH::Node& node = nodes[index];
+    if (node.count > 0) {
+        node.bounds = AABB();
+        for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+            const Object* object = objects[indices[i]];
+            node.bounds.expand(objectKind(object).getBounds(*object));
+        }
+        return;
+    }
+
+    uint32_t first = index + 1;
+    uint32_t second = node.offset;
+    refitRecursive(nodes, indices, objects, first, second);
+    refitRecursive(nodes, indices, objects, second, end);
+
+    node.bounds = nodes[first].bounds;
+    node.bounds.expand(nodes[second].bounds);
+}
+
+// Splits the top `levels` levels of the subtree in nodes[index, end) into the
+// subtrees below them, refitted as separate jobs, and the interior nodes above
+// them, in depth-first order. Small subtrees are not split further.
+void splitRefit(const std::vector<BVH::Node>& nodes, uint32_t index, uint32_t end, int levels,
+                std::vector<std::pair<uint32_t, uint32_t>>& subtrees, std::vector<uint32_t>& top) {
+    const BVH::Node& node = nodes[index];
+    if (node.count > 0 || levels == 0 || end - index <= PARALLEL_THRESHOLD) {
+        subtrees.emplace_back(index, end);
+        return;
+    }
+    top.push_back(index);
+    splitRefit(nodes, index + 1, node.offset, levels - 1, subtrees, top);
+    splitRefit(nodes, node.offset, end, levels - 1, subtrees, top);
+}
+
+// Rays of a packet stored structure-of-arrays, padded to a multiple of four lanes
+struct PacketLanes {
+    alignas(16) float originX[RayPacket::MAX_SIZE];
+    alignas(16) float originY[RayPacket::MAX_SIZE];
+    alignas(16) float originZ[RayPacket::MAX_SIZE];
+    alignas(16) float invX[RayPacket::MAX_SIZE];
+    alignas(16) float invY[RayPacket::MAX_SIZE];
+    alignas(16) float invZ[RayPacket::MAX_SIZE];
+    alignas(16) float tMax[RayPacket::MAX_SIZE];
+    int groups;
+
+    // Ranges of the origins and inverse directions over the packet
+    glm::vec3 originMin, originMax;
+    glm::vec3 invMin, invMax;
+    bool dirIsNeg[3];
+};
+
+// Smallest and largest product of a value in [a0, a1] and one in [b0, b1]
+void intervalProduct(float a0, float a1, float b0, float b1, float& low, float& high) {
+    float p0 = a0 * b0, p1 = a0 * b1, p2 = a1 * b0, p3 = a1 * b1;
+    low = std::min(std::min(p0, p1), std::min(p2, p3));
+    high = std::max(std::max(p0, p1), std::max(p2, p3));
+}
+
+// Whether some lane may reach the box before `tMax`, the largest lane tMax. The
+// bounds hold for every lane because rounding is monotonic, and they are padded
+// like AABB::rayIntersect, so a box a lane would accept is never culled.
+bool packetMayHit(const PacketLanes& lanes, const AABB& box, float tMax) {
+    float tNear = -std::numeric_limits<float>::max();
+    float tFar = std::numeric_limits<float>::max();
+    for (int axis = 0; axis < 3; axis++) {
+        float nearPlane = lanes.dirIsNeg[axis] ? box.max[axis] : box.min[axis];
+        float farPlane = lanes.dirIsNeg[axis] ? box.min[axis] : box.max[axis];
+        float low, high, unused;
+        intervalProduct(nearPlane - lanes.originMax[axis], nearPlane - lanes.originMin[axis],
+                        lanes.invMin[axis], lanes.invMax[axis], low, unused);
+        tNear = std::max(tNear, low);
+        intervalProduct(farPlane - lanes.originMax[axis], farPlane - lanes.originMin[axis],
+                        lanes.invMin[axis], lanes.invMax[axis], unused, high);
+        tFar = std::min(tFar, high);
+    }
+    tNear -= std::abs(tNear) * 1e-5f;
+    tFar += std::abs(tFar) * 1e-5f;
+    return tNear <= tFar && tFar >= 0 && tNear <= tMax;
+}
+
+// AABB::rayIntersect for the lanes in `mask`, returns those that hit the box
+int laneMask(const PacketLanes& lanes, const AABB& box, int mask) {
+    int result = 0;
+    for (int group = 0; group < lanes.groups; group++) {
+        int offset = group * 4;
+        if (((mask >> offset) & 0xf) == 0) {
+            continue;
+        }
+#ifdef BVH_SSE
+        const __m128 ox = _mm_load_ps(lanes.originX + offset);
+        const __m128 oy = _mm_load_ps(lanes.originY + offset);
+        const __m128 oz = _mm_load_ps(lanes.originZ + offset);
+        const __m128 ix = _mm_load_ps(lanes.invX + offset);
+        const __m128 iy = _mm_load_ps(lanes.invY + offset);
+        const __m128 iz = _mm_load_ps(lanes.invZ + offset);
+
+        __m128 x0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.min.x), ox), ix);
+        __m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.min.y), oy), iy);
+        __m128 z0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.min.z), oz), iz);
+        __m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.max.x), ox), ix);
+        __m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.max.y), oy), iy);
+        __m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.max.z), oz), iz);
+
+        __m128 tNear = _mm_max_ps(_mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)), _mm_min_ps(z0, z1));
+        __m128 tFar = _mm_min_ps(_mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)), _mm_max_ps(z0, z1));
+
+        const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+        const __m128 padding = _mm_set1_ps(1e-5f);
+        tNear = _mm_sub_ps(tNear, _mm_mul_ps(_mm_and_ps(tNear, absMask), padding));
+        tFar = _mm_add_ps(tFar, _mm_mul_ps(_mm_and_ps(tFar, absMask), padding));
+
+        __m128 hit = _mm_and_ps(_mm_and_ps(_mm_cmple_ps(tNear, tFar), _mm_cmpge_ps(tFar, _mm_setzero_ps())),
+                                _mm_cmple_ps(tNear, _mm_load_ps(lanes.tMax + offset)));
+        result |= _mm_movemask_ps(hit) << offset;
+#else
+        for (int lane = offset; lane < offset + 4; lane++) {
+            glm::vec3 origin(lanes.originX[lane], lanes.originY[lane], lanes.originZ[lane]);
+            glm::vec3 invDirection(lanes.invX[lane], lanes.invY[lane], lanes.invZ[lane]);
+            if (box.rayIntersect(origin, invDirection, lanes.tMax[lane])) {
+                result |= 1 << lane;
+            }
+        }
+#endif
+    }
+    return result & mask;
+}
+
+}
+
+void BVH::build(const std::vector<Object*>& sceneObjects) {
+    objects = sceneObjects;
+
+    std::vector<AABB> bounds;
+    bounds.reserve(objects.size());
+    for (const auto& object : objects) {
+        bounds.push_back(object->getBounds());
+    }
+    build(bounds);
+    store.build(objects, indices);
+}
+
+void BVH::build(const std::vector<AABB>& bounds) {
+    nodes.clear();
+    indices.clear();
+    if (bounds.empty()) {
+        return;
+    }
+
+    std::vector<BuildPrimitive> prims(bounds.size());
+    for (size_t i = 0; i < bounds.size(); i++) {
+        prims[i] = {bounds[i], bounds[i].centroid(), static_cast<uint32_t>(i)};
+    }
+
+    std::unique_ptr<BuildNode> root = buildRecursive(prims, 0, prims.size(), 0);
+
+    nodes.reserve(root->nodeCount);
+    flatten(root.get(), nodes);
+
+    indices.resize(prims.size());
+    for (size_t i = 0; i < prims.size(); i++) {
+        indices[i] = prims[i].index;
+    }
+    buildCost = getCost();
+}
+
+void BVH::refit(RenderPool& pool) {
+    if (nodes.empty() || indices.size() != objects.size()) {
+        build(objects);
+        return;
+    }
+
+    // A few subtrees per worker, so that the ones with more moving objects even out
+    int levels = 2;
+    while ((1 << levels) < pool.getThreadCount() * 4) {
+        levels++;
+    }
+    std::vector<std::pair<uint32_t, uint32_t>> subtrees;
+    std::vector<uint32_t> top;
+    splitRefit(nodes, 0, static_cast<uint32_t>(nodes.size()), levels, subtrees, top);
+    pool.run(static_cast<int>(subtrees.size()), [&](int subtree, int) {
+        refitRecursive(nodes, indices, objects, subtrees[subtree].first, subtrees[subtree].second);
+    });
+
+    // Children come after their parent, so going backwards finds them refitted
+    for (auto it = top.rbegin(); it != top.rend(); ++it) {
+        Node& node = nodes[*it];
+        node.bounds = nodes[*it + 1].bounds;
+        node.bounds.expand(nodes[node.offset].bounds);
+    }
+    store.update(objects);
+    stats.refits++;
+
+    // Moving objects stretch the boxes until the tree is no better than a bad split
+    if (getCost() > buildCost * REBUILD_THRESHOLD) {
+        build(objects);
+        stats.rebuilds++;
+    }
+}
+
+float BVH::getCost() const {
+    if (nodes.empty()) {
+        return 0.0f;
+    }
+    float cost = 0.0f;
+    for (const Node& node : nodes) {
+        cost += node.bounds.surfaceArea() * (node.count > 0 ? INTERSECTION_COST * node.count : TRAVERSAL_COST);
+    }
+    return cost / std::max(nodes[0].bounds.surfaceArea(), 1e-12f);
+}
+
+bool BVH::occluded(const Ray& ray, const Object*& occluder, const Object* ignore, const Object* ignoreOwner) const {
+    AnyHit anyHit{ray, ignore, ignoreOwner};
+    traverse(anyHit.ray, [&](uint32_t index) {
+        return anyHit.test(objects[index]);
+    });
+    occluder = anyHit.occluder;
+    return occluder != nullptr;
+}
+
+size_t BVH::getMemoryUsage() const {
+    return nodes.size() * sizeof(Node) + indices.size() * sizeof(uint32_t) + store.getMemoryUsage();
+}
+
+void BVH::findClosest(ClosestHit& closest) const {
+    traverseLeaves(closest.ray, [&](uint32_t first, uint32_t count) {
+        store.intersect(first, count, objects, closest);
+    });
+}
+
+Intersect BVH::rayIntersect(const Ray& ray, Object*& hitObject, const Object* ignore,
+                            const Object* ignoreOwner) const {
+    ClosestHit closest{ray, ignore, ignoreOwner};
+    findClosest(closest);
+
+    hitObject = closest.object;
+    return closest.finalize();
+}
+
+void BVH::rayIntersectPacket(RayPacket& packet) const {
+    stats.packets++;
+    PacketLanes lanes;
+    lanes.groups = (packet.size + 3) / 4;
+
+    // Lanes must agree on the direction sign of every axis for the interval test
+    // and the near child order to make sense. Rays with a zero component are
+    // left to the single-ray path.
+    ClosestHit closest[RayPacket::MAX_SIZE];
+    bool coherent = !nodes.empty();
+    for (int i = 0; i < packet.size && coherent; i++) {
+        closest[i] = ClosestHit{Ray(packet.origins[i], packet.directions[i]), nullptr};
+        const Ray& ray = closest[i].ray;
+        for (int axis = 0; axis < 3; axis++) {
+            if (ray.direction[axis] == 0.0f || (i > 0 && ray.dirIsNeg[axis] != lanes.dirIsNeg[axis])) {
+                coherent = false;
+            }
+            lanes.dirIsNeg[axis] = ray.dirIsNeg[axis];
+        }
+        lanes.originX[i] = ray.origin.x;
+        lanes.originY[i] = ray.origin.y;
+        lanes.originZ[i] = ray.origin.z;
+        lanes.invX[i] = ray.invDirection.x;
+        lanes.invY[i] = ray.invDirection.y;
+        lanes.invZ[i] = ray.invDirection.z;
+        lanes.tMax[i] = ray.tMax;
+    }
+    if (!coherent) {
+        stats.packetFallbacks++;
+        Accelerator::rayIntersectPacket(packet);
+        return;
+    }
+
+    // Padding lanes copy the first ray and are left out of every mask
+    for (int i = packet.size; i < lanes.groups * 4; i++) {
+        lanes.originX[i] = lanes.originX[0];
+        lanes.originY[i] = lanes.originY[0];
+        lanes.originZ[i] = lanes.originZ[0];
+        lanes.invX[i] = lanes.invX[0];
+        lanes.invY[i] = lanes.invY[0];
+        lanes.invZ[i] = lanes.invZ[0];
+        lanes.tMax[i] = lanes.tMax[0];
+    }
+    lanes.originMin = lanes.originMax = packet.origins[0];
+    lanes.invMin = lanes.invMax = glm::vec3(lanes.invX[0], lanes.invY[0], lanes.invZ[0]);
+    for (int i = 1; i < packet.size; i++) {
+        glm::vec3 invDirection(lanes.invX[i], lanes.invY[i], lanes.invZ[i]);
+        lanes.originMin = glm::min(lanes.originMin, packet.origins[i]);
+        lanes.originMax = glm::max(lanes.originMax, packet.origins[i]);
+        lanes.invMin = glm::min(lanes.invMin, invDirection);
+        lanes.invMax = glm::max(lanes.invMax, invDirection);
+    }
+
+    float packetTMax = std::numeric_limits<float>::max();
+
+    // Each entry carries the lanes that reached its parent
+    struct Entry {
+        uint32_t node;
+        int mask;
+    };
+    Entry stack[64];
+    int stackSize = 0;
+    stack[stackSize++] = {0, (1 << packet.size) - 1};
+
+    while (stackSize > 0) {
+        Entry entry = stack[--stackSize];
+        const Node& node = nodes[entry.node];
+        stats.nodeVisits++;
+
+        if (!packetMayHit(lanes, node.bounds, packetTMax)) {
+            continue;
+        }
+        int mask = laneMask(lanes, node.bounds, entry.mask);
+        if (mask == 0) {
+            continue;
+        }
+
+        if (node.count == 0) {
+            uint32_t first = entry.node + 1;
+            uint32_t second = node.offset;
+            if (lanes.dirIsNeg[node.axis]) {
+                std::swap(first, second);
+            }
+            stack[stackSize++] = {second, mask};
+            stack[stackSize++] = {first, mask};
+            continue;
+        }
+
+        for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+            uint32_t index = indices[i];
+            Object* object = objects[index];
+            int primitiveMask = object->hasParts ? mask : laneMask(lanes, objectKind(object).getBounds(*object), mask);
+            for (int lane = 0; primitiveMask != 0; lane++, primitiveMask >>= 1) {
+                if (primitiveMask & 1) {
+                    closest[lane].test(object, index);
+                    lanes.tMax[lane] = closest[lane].ray.tMax;
+                }
+            }
+        }
+        packetTMax = *std::max_element(lanes.tMax, lanes.tMax + packet.size);
+    }
+
+    // Only the closest hit of each lane gets its point and normal
+    for (int lane = 0; lane < packet.size; lane++) {
+        packet.intersects[lane] = closest[lane].finalize();
+        packet.objects[lane] = closest[lane].object;
+    }
+}
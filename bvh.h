@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+#include "glm/glm.hpp"
+#include "aabb.h"
+#include "accelerator.h"
+#include "intersect.h"
+#include "object.h"
+#include "primitivestore.h"
+#include "stats.h"
+
+// Bounding volume hierarchy built with a binned surface area heuristic.
+// Nodes are stored depth-first: the first child of an interior node is the next
+// node in the array and the second child is at `offset`.
+class BVH : public Accelerator {
+public:
+    struct Node {
+        AABB bounds;
+        uint32_t offset;    // first entry in `indices` for leaves, second child otherwise
+        uint16_t count;     // primitives in the leaf, 0 for interior nodes
+        uint8_t axis;       // split axis, used to visit the near child first
+    };
+
+    // Builds over the bounds of the scene objects
+    void build(const std::vector<Object*>& sceneObjects) override;
+
+    // Builds over arbitrary primitive bounds; leaves reference them through `indices`
+    void build(const std::vector<AABB>& bounds);
+
+    Intersect rayIntersect(const Ray& ray, Object*& hitObject, const Object* ignore = nullptr,
+                           const Object* ignoreOwner = nullptr) const override;
+
+    // Traces the rays together when their directions share signs on every axis:
+    // a node is skipped when interval bounds over the whole packet miss it, then
+    // SSE tests four lanes at a time and only the lanes that reach it go on.
+    // Incoherent packets fall back to rayIntersect for each ray.
+    void rayIntersectPacket(RayPacket& packet) const override;
+
+    // Recomputes the node boxes bottom-up, subtrees as jobs of `pool`, and rebuilds
+    // only when the SAH cost has grown past REBUILD_THRESHOLD times the cost at build
+    void refit(RenderPool& pool) override;
+
+    // SAH cost of the tree relative to its root box
+    float getCost() const;
+
+    bool occluded(const Ray& ray, const Object*& occluder, const Object* ignore = nullptr,
+                  const Object* ignoreOwner = nullptr) const override;
+
+    // Offers every object its ray reaches before ray.tMax to `closest`, testing
+    // the leaves through the primitive store
+    void findClosest(ClosestHit& closest) const;
+
+    size_t getMemoryUsage() const override;
+
+    std::string getName() const override {
+        return "bvh";
+    }
+
+    // Visits every leaf primitive whose node the ray reaches before ray.tMax, near
+    // child first. test(index) may shrink ray.tMax (the ray is read again at every
+    // node) to prune the remaining nodes, and when it returns bool, returning true
+    // ends the traversal.
+    template <typename PrimitiveTest>
+    void traverse(const Ray& ray, PrimitiveTest&& test) const;
+
+    // Same, visiting whole leaves: test(first, count) gets the leaf range in `indices`
+    template <typename LeafTest>
+    void traverseLeaves(const Ray& ray, LeafTest&& test) const;
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> indices;
+    PrimitiveStore store;    // the objects in `indices` order, filled by build(objects)
+
+private:
+    static constexpr float REBUILD_THRESHOLD = 1.5f;
+
+    float buildCost = 0.0f;
+};
+
+template <typename PrimitiveTest>
+void BVH::traverse(const Ray& ray, PrimitiveTest&& test) const {
+    traverseLeaves(ray, [&](uint32_t first, uint32_t count) {
+        for (uint32_t i = first; i < first + count; i++) {
+            if constexpr (std::is_same_v<decltype(test(indices[i])), bool>) {
+                if (test(indices[i])) {
+                    return true;
+                }
+            } else {
+                test(indices[i]);
+            }
+        }
+        if constexpr (std::is_same_v<decltype(test(indices[first])), bool>) {
+            return false;
+        }
+    });
+}
+
+template <typename LeafTest>
+void BVH::traverseLeaves(const Ray& ray, LeafTest&& test) const {
+    if (nodes.empty()) {
+        return;
+    }
+
+    uint32_t stack[64];
+    int stackSize = 0;
+    uint32_t current = 0;
+
+    while (true) {
+        const Node& node = nodes[current];
+        stats.nodeVisits++;
+
+        if (node.bounds.rayIntersect(ray)) {
+            if (node.count > 0) {
+                if constexpr (std::is_same_v<decltype(test(node.offset, node.count)), bool>) {
+                    if (test(node.offset, node.count)) {
+                        return;
+                    }
+                } else {
+                    test(node.offset, node.count);
+                }
+            } else if (ray.dirIsNeg[node.axis]) {
+                stack[stackSize++] = current + 1;
+                current = node.offset;
+                continue;
+            } else {
+                stack[stackSize++] = node.offset;
+                current = current + 1;
+                continue;
+            }
+        }
+
+        if (stackSize == 0) {
+            break;
+        }
+        current = stack[--stackSize];
+    }
+}
@@ -3,13 +3,16 @@
 #include <algorithm>
 #include <iostream>
 
+// Bytes in the order of SDL_PIXELFORMAT_BGRA32 (ARGB8888 on little-endian),
+// the texture format every SDL renderer takes without converting, so a frame
+// of Colors is uploaded as it is
 struct Color {
-    Uint8 r;
-    Uint8 g;
     Uint8 b;
+    Uint8 g;
+    Uint8 r;
     Uint8 a;
 
-    Color() : r(0), g(0), b(0), a(255) {}
+    Color() : b(0), g(0), r(0), a(255) {}
 
     Color(int red, int green, int blue, int alpha = 255) {
         r = static_cast<Uint8>(std::min(std::max(red, 0), 255));
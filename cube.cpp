@@ -1,12 +1,14 @@
 #include "cube.h"
 
-Cube::Cube(const glm::vec3& minCorner, const glm::vec3& maxCorner, const Material& mat)
-        : minCorner(minCorner), maxCorner(maxCorner), Object(mat) {}
+const uint8_t Cube::KIND = registerObjectKind<Cube>();
 
+Cube::Cube(const glm::vec3& minCorner, const glm::vec3& maxCorner, uint16_t material)
+        : minCorner(minCorner), maxCorner(maxCorner), Object(material, KIND) {}
 
-Intersect Cube::rayIntersect(const glm::vec3& rayOrigin, const glm::vec3& rayDirection) const {
-    glm::vec3 tMin = (minCorner - rayOrigin) / rayDirection;
-    glm::vec3 tMax = (maxCorner - rayOrigin) / rayDirection;
+
+Hit Cube::hit(const Ray& ray) const {
+    glm::vec3 tMin = (minCorner - ray.origin) * ray.invDirection;
+    glm::vec3 tMax = (maxCorner - ray.origin) * ray.invDirection;
 
     glm::vec3 t1 = glm::min(tMin, tMax);
     glm::vec3 t2 = glm::max(tMin, tMax);
@@ -14,27 +16,49 @@ Intersect Cube::rayIntersect(const glm::vec3& rayOrigin, const glm::vec3& rayDir
     float tNear = glm::max(glm::max(t1.x, t1.y), t1.z);
     float tFar = glm::min(glm::min(t2.x, t2.y), t2.z);
 
-    if (tNear > tFar || tFar < 0) {
-        return Intersect{false};
+    // Beyond tMax means behind the closest hit found so far
+    if (tNear > tFar || tFar < 0 || tNear > ray.tMax) {
+        return Hit{false};
     }
 
-    glm::vec3 point = rayOrigin + tNear * rayDirection;
-
-    glm::vec3 normal;
-    if (point.x < minCorner.x + 1e-5) {
-        normal = glm::vec3(-1.0f, 0.0f, 0.0f);
-    } else if (point.x > maxCorner.x - 1e-5) {
-        normal = glm::vec3(1.0f, 0.0f, 0.0f);
-    } else if (point.y < minCorner.y + 1e-5) {
-        normal = glm::vec3(0.0f, -1.0f, 0.0f);
-    } else if (point.y > maxCorner.y - 1e-5) {
-        normal = glm::vec3(0.0f, 1.0f, 0.0f);
-    } else if (point.z < minCorner.z + 1e-5) {
-        normal = glm::vec3(0.0f, 0.0f, -1.0f);
-    } else if (point.z > maxCorner.z - 1e-5) {
-        normal = glm::vec3(0.0f, 0.0f, 1.0f);
+    // The slab that gave tNear is the face the ray enters through
+    int axis = tNear == t1.x ? 0 : (tNear == t1.y ? 1 : 2);
+    return Hit{true, tNear, faceIndex(axis, ray.dirIsNeg[axis])};
+}
+
+Intersect Cube::finalize(const Ray& ray, const Hit& hit) const {
+    if (!hit.isIntersecting) {
+        return Intersect{false};
     }
 
-    return Intersect{true, tNear, point, normal};
+    int axis = hit.face / 2;
+    glm::vec3 normal(0.0f);
+    normal[axis] = hit.face % 2 == 1 ? 1.0f : -1.0f;
+
+    glm::vec3 point = ray.origin + hit.dist * ray.direction;
+    glm::vec3 low = glm::min(minCorner, maxCorner);
+    glm::vec3 size = glm::abs(maxCorner - minCorner);
+    int u = (axis + 1) % 3;
+    int v = (axis + 2) % 3;
+    glm::vec2 uv((point[u] - low[u]) / size[u], (point[v] - low[v]) / size[v]);
+
+    return Intersect{true, hit.dist, point, normal, uv};
 }
 
+bool Cube::occluded(const Ray& ray) const {
+    glm::vec3 tLow = (minCorner - ray.origin) * ray.invDirection;
+    glm::vec3 tHigh = (maxCorner - ray.origin) * ray.invDirection;
+
+    glm::vec3 t1 = glm::min(tLow, tHigh);
+    glm::vec3 t2 = glm::max(tLow, tHigh);
+
+    float tNear = glm::max(glm::max(t1.x, t1.y), t1.z);
+    float tFar = glm::min(glm::min(t2.x, t2.y), t2.z);
+
+    // Same distance hit reports, so both agree on what is in front
+    return tNear <= tFar && tFar >= 0 && tNear > ray.tMin && tNear < ray.tMax;
+}
+
+AABB Cube::getBounds() const {
+    return AABB(minCorner, maxCorner);
+}
@@ -7,17 +7,34 @@
 
 class Cube : public Object {
 public:
-    Cube(const glm::vec3& minCorner, const glm::vec3& maxCorner, const Material& mat);
+    static const uint8_t KIND;
 
-    Intersect rayIntersect(const glm::vec3& rayOrigin, const glm::vec3& rayDirection) const override;
+    // Hit::face of the face crossed along `axis`, 2 * axis + 1 when its normal points to +axis
+    static uint8_t faceIndex(int axis, bool positive) {
+        return static_cast<uint8_t>(2 * axis + (positive ? 1 : 0));
+    }
+
+    Cube(const glm::vec3& minCorner, const glm::vec3& maxCorner, uint16_t material);
+
+    Hit hit(const Ray& ray) const override;
+    Intersect finalize(const Ray& ray, const Hit& hit) const override;
+    bool occluded(const Ray& ray) const override;
+    AABB getBounds() const override;
 
+    const glm::vec3& getMinCorner() const {
+        return minCorner;
+    }
+
+    const glm::vec3& getMaxCorner() const {
+        return maxCorner;
+    }
 
-    // Método para establecer la textura del cubo
-    void setTexture(SDL_Texture* tex) {
-        texture = tex;
+    // Moves the cube; call Accelerator::refit before tracing again
+    void setCorners(const glm::vec3& min, const glm::vec3& max) {
+        minCorner = min;
+        maxCorner = max;
     }
 private:
     glm::vec3 minCorner;
     glm::vec3 maxCorner;
-    SDL_Texture* texture;
 };
@@ -0,0 +1,28 @@
+#include "framebuffer.h"
+#include <memory>
+#include <new>
+
+namespace {
+
+const size_t CACHE_LINE = 64;
+
+}
+
+Framebuffer::Framebuffer(SDL_Renderer* renderer, int width, int height)
+    : renderer(renderer), width(width), height(height) {
+    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_BGRA32, SDL_TEXTUREACCESS_STREAMING, width, height);
+    pixels = static_cast<Color*>(::operator new(sizeof(Color) * width * height, std::align_val_t(CACHE_LINE)));
+    std::uninitialized_default_construct_n(pixels, width * height);
+}
+
+Framebuffer::~Framebuffer() {
+    ::operator delete(pixels, std::align_val_t(CACHE_LINE));
+    if (texture) {
+        SDL_DestroyTexture(texture);
+    }
+}
+
+void Framebuffer::present() {
+    SDL_UpdateTexture(texture, nullptr, pixels, width * sizeof(Color));
+    SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <SDL_render.h>
+#include "color.h"
+
+// The pixels of a frame, laid out like a streaming SDL texture: width Colors
+// per row, rows one after the other, 64-byte aligned. The render threads write
+// them directly; present() uploads the whole frame with one call and draws it
+// with one copy, with no SDL call per pixel.
+class Framebuffer {
+public:
+    Framebuffer(SDL_Renderer* renderer, int width, int height);
+    Framebuffer(const Framebuffer&) = delete;
+    Framebuffer& operator=(const Framebuffer&) = delete;
+    ~Framebuffer();
+
+    // Null when SDL could not create the texture
+    SDL_Texture* getTexture() const {
+        return texture;
+    }
+
+    int getWidth() const {
+        return width;
+    }
+
+    int getHeight() const {
+        return height;
+    }
+
+    Color& at(int x, int y) {
+        return pixels[y * width + x];
+    }
+
+    // Uploads the pixels and copies them over the whole window
+    void present();
+
+private:
+    SDL_Renderer* renderer;
+    SDL_Texture* texture;
+    int width;
+    int height;
+    Color* pixels;
+};
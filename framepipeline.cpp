@@ -0,0 +1,72 @@
+#include "framepipeline.h"
+
+FramePipeline::FramePipeline(SDL_Renderer* renderer, int width, int height, int bufferCount) {
+    for (int i = 0; i < bufferCount; i++) {
+        buffers.emplace_back(new Framebuffer(renderer, width, height));
+    }
+}
+
+bool FramePipeline::isValid() const {
+    for (const auto& buffer : buffers) {
+        if (!buffer->getTexture()) {
+            return false;
+        }
+    }
+    return !buffers.empty();
+}
+
+Framebuffer* FramePipeline::acquire() {
+    std::unique_lock<std::mutex> lock(mutex);
+    int index = -1;
+    freed.wait(lock, [&] {
+        for (index = 0; index < getBufferCount() && !isFree(index); index++) {
+        }
+        return stopping || index < getBufferCount();
+    });
+    if (stopping) {
+        return nullptr;
+    }
+    rendering = index;
+    return buffers[index].get();
+}
+
+void FramePipeline::publish(Stats& frameStats) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (ready >= 0) {
+            frameStats.framesDropped++;
+        }
+        ready = rendering;
+        rendering = -1;
+        pending.add(frameStats);
+    }
+    frameStats.reset();
+    published.notify_one();
+}
+
+Framebuffer* FramePipeline::takeFrame(std::chrono::milliseconds timeout) {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!published.wait_for(lock, timeout, [&] { return ready >= 0; })) {
+            return nullptr;
+        }
+        shown = ready;
+        ready = -1;
+        stats.add(pending);
+        pending.reset();
+    }
+    freed.notify_one();
+    return buffers[shown].get();
+}
+
+void FramePipeline::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    freed.notify_one();
+}
+
+bool FramePipeline::isFree(int index) const {
+    return index != rendering && index != ready && index != shown;
+}
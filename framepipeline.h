@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "framebuffer.h"
+#include "stats.h"
+
+// Hands finished frames from the render thread to the main thread, which keeps
+// handling events and presenting while the next frame renders. With two buffers
+// the render thread waits for each frame to be shown before starting the one
+// after it; with three it never waits, and a finished frame that was not shown
+// yet is replaced by the newer one.
+class FramePipeline {
+public:
+    // Creates the textures, so it must be called on the thread that presents
+    FramePipeline(SDL_Renderer* renderer, int width, int height, int bufferCount);
+
+    // False when SDL could not create a texture
+    bool isValid() const;
+
+    int getBufferCount() const {
+        return static_cast<int>(buffers.size());
+    }
+
+    // Render thread: the buffer to render the next frame into, once one is
+    // neither shown nor waiting to be. Null after stop().
+    Framebuffer* acquire();
+
+    // Render thread: the acquired buffer holds a finished frame. The counters of
+    // the frame go with it and are reset.
+    void publish(Stats& frameStats);
+
+    // Main thread: the newest finished frame, waiting at most timeout for one,
+    // or null. It stays untouched until the next call; the counters of the
+    // frames published since the last one are added to the caller's stats.
+    Framebuffer* takeFrame(std::chrono::milliseconds timeout);
+
+    // Wakes the render thread for good
+    void stop();
+
+private:
+    bool isFree(int index) const;
+
+    std::vector<std::unique_ptr<Framebuffer>> buffers;
+    int rendering = -1;     // owned by the render thread
+    int ready = -1;         // finished, not shown yet
+    int shown = -1;         // being presented by the main thread
+    Stats pending;          // counters of the frames published and not taken
+
+    std::mutex mutex;
+    std::condition_variable freed;
+    std::condition_variable published;
+    bool stopping = false;
+};
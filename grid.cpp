@@ -0,0 +1,277 @@
+#include "grid.h"
+#include <algorithm>
+#include <cmath>
+#include "cube.h"
+#include "stats.h"
+
+namespace {
+
+// A cube whose corners are given in order reports the face it is entered through,
+// which is what the grid assumes when it hits a solid cell without testing it
+bool isVoxel(const Object* object) {
+    if (object->kind != Cube::KIND) {
+        return false;
+    }
+    auto cube = static_cast<const Cube*>(object);
+    return glm::all(glm::lessThan(cube->getMinCorner(), cube->getMaxCorner()));
+}
+
+// Objects spanning several cells are only tested once per ray
+struct Mailbox {
+    uint32_t recent[8];
+    int next = 0;
+
+    Mailbox() {
+        std::fill(std::begin(recent), std::end(recent), std::numeric_limits<uint32_t>::max());
+    }
+
+    // False when the object was already tested
+    bool visit(uint32_t index) {
+        if (std::find(std::begin(recent), std::end(recent), index) != std::end(recent)) {
+            return false;
+        }
+        recent[next++ & 7] = index;
+        return true;
+    }
+};
+
+}
+
+void UniformGrid::build(const std::vector<Object*>& sceneObjects) {
+    objects = sceneObjects;
+    cells.clear();
+    lists.clear();
+    resolution = glm::ivec3(0);
+    if (objects.empty()) {
+        return;
+    }
+
+    std::vector<AABB> objectBounds;
+    objectBounds.reserve(objects.size());
+    bounds = AABB();
+    for (const auto& object : objects) {
+        objectBounds.push_back(object->getBounds());
+        bounds.expand(objectBounds.back());
+    }
+
+    origin = glm::floor(bounds.min);
+    cellSize = 1.0f;
+    while (true) {
+        resolution = glm::max(glm::ivec3(glm::ceil((bounds.max - origin) / cellSize)), glm::ivec3(1));
+        if (static_cast<size_t>(resolution.x) * resolution.y * resolution.z <= MAX_CELLS) {
+            break;
+        }
+        cellSize *= 2.0f;
+    }
+    size_t cellCount = static_cast<size_t>(resolution.x) * resolution.y * resolution.z;
+
+    auto cellRange = [&](const AABB& box, glm::ivec3& low, glm::ivec3& high) {
+        low = glm::clamp(glm::ivec3(glm::floor((box.min - origin) / cellSize)), glm::ivec3(0), resolution - 1);
+        high = glm::clamp(glm::ivec3(glm::ceil((box.max - origin) / cellSize)) - 1, low, resolution - 1);
+    };
+
+    // First pass: how many objects overlap each cell, and which one if it is alone
+    std::vector<uint32_t> counts(cellCount, 0);
+    std::vector<uint32_t> single(cellCount, 0);
+    for (uint32_t i = 0; i < objects.size(); i++) {
+        glm::ivec3 low, high;
+        cellRange(objectBounds[i], low, high);
+        for (int z = low.z; z <= high.z; z++) {
+            for (int y = low.y; y <= high.y; y++) {
+                for (int x = low.x; x <= high.x; x++) {
+                    int c = cellIndex(x, y, z);
+                    counts[c]++;
+                    single[c] = i;
+                }
+            }
+        }
+    }
+
+    // Cells filled by exactly one voxel cube become solid, the rest get a list
+    cells.assign(cellCount, EMPTY);
+    for (int z = 0; z < resolution.z; z++) {
+        for (int y = 0; y < resolution.y; y++) {
+            for (int x = 0; x < resolution.x; x++) {
+                int c = cellIndex(x, y, z);
+                if (counts[c] == 0) {
+                    continue;
+                }
+                if (counts[c] == 1 && isVoxel(objects[single[c]])) {
+                    glm::vec3 cellMin = origin + glm::vec3(x, y, z) * cellSize;
+                    const AABB& box = objectBounds[single[c]];
+                    if (box.min == cellMin && box.max == cellMin + cellSize) {
+                        cells[c] = SOLID | single[c];
+                        continue;
+                    }
+                }
+                cells[c] = LIST | static_cast<uint32_t>(lists.size());
+                lists.push_back(0);
+                lists.resize(lists.size() + counts[c]);
+            }
+        }
+    }
+
+    // Second pass: fill the lists, using the first entry as the running count
+    for (uint32_t i = 0; i < objects.size(); i++) {
+        glm::ivec3 low, high;
+        cellRange(objectBounds[i], low, high);
+        for (int z = low.z; z <= high.z; z++) {
+            for (int y = low.y; y <= high.y; y++) {
+                for (int x = low.x; x <= high.x; x++) {
+                    uint32_t cell = cells[cellIndex(x, y, z)];
+                    if (cell & LIST) {
+                        uint32_t* list = &lists[cell & PAYLOAD];
+                        list[1 + list[0]++] = i;
+                    }
+                }
+            }
+        }
+    }
+}
+
+size_t UniformGrid::getMemoryUsage() const {
+    return (cells.size() + lists.size()) * sizeof(uint32_t);
+}
+
+template <typename CellVisitor>
+void UniformGrid::walk(const Ray& ray, CellVisitor&& visit) const {
+    if (cells.empty()) {
+        return;
+    }
+
+    const float infinity = std::numeric_limits<float>::infinity();
+    const glm::vec3& rayOrigin = ray.origin;
+    const glm::vec3& rayDirection = ray.direction;
+    const glm::vec3& invDirection = ray.invDirection;
+    glm::vec3 gridMax = origin + glm::vec3(resolution) * cellSize;
+
+    // Clip the ray against the grid box
+    float tEnter = -infinity;
+    float tExit = infinity;
+    for (int axis = 0; axis < 3; axis++) {
+        if (rayDirection[axis] == 0.0f) {
+            if (rayOrigin[axis] < origin[axis] || rayOrigin[axis] > gridMax[axis]) {
+                return;
+            }
+            continue;
+        }
+        float t0 = (origin[axis] - rayOrigin[axis]) * invDirection[axis];
+        float t1 = (gridMax[axis] - rayOrigin[axis]) * invDirection[axis];
+        tEnter = std::max(tEnter, std::min(t0, t1));
+        tExit = std::min(tExit, std::max(t0, t1));
+    }
+    // Hits at or before tMin are not wanted, so the walk starts there: rays
+    // traced again past a surface they cross do not visit the cells before it
+    float tStart = std::max(ray.tMin, 0.0f);
+    if (tEnter > tExit || tExit < tStart) {
+        return;
+    }
+
+    float tCellEnter = std::max(tEnter, tStart);
+    glm::vec3 start = rayOrigin + rayDirection * tCellEnter;
+    glm::ivec3 cell = glm::clamp(glm::ivec3(glm::floor((start - origin) / cellSize)), glm::ivec3(0), resolution - 1);
+
+    glm::ivec3 step;
+    glm::vec3 tNext;
+    glm::vec3 tDelta;
+    for (int axis = 0; axis < 3; axis++) {
+        if (rayDirection[axis] > 0) {
+            step[axis] = 1;
+            tNext[axis] = (origin[axis] + (cell[axis] + 1) * cellSize - rayOrigin[axis]) * invDirection[axis];
+            tDelta[axis] = cellSize * invDirection[axis];
+        } else if (rayDirection[axis] < 0) {
+            step[axis] = -1;
+            tNext[axis] = (origin[axis] + cell[axis] * cellSize - rayOrigin[axis]) * invDirection[axis];
+            tDelta[axis] = -cellSize * invDirection[axis];
+        } else {
+            step[axis] = 0;
+            tNext[axis] = infinity;
+            tDelta[axis] = infinity;
+        }
+    }
+
+    int enteredAxis = -1;
+    while (true) {
+        stats.nodeVisits++;
+        float tCellExit = std::min(std::min(tNext.x, tNext.y), tNext.z);
+        if (visit(cells[cellIndex(cell.x, cell.y, cell.z)], tCellEnter, tCellExit, enteredAxis)) {
+            break;
+        }
+
+        int axis = tNext.x < tNext.y ? (tNext.x < tNext.z ? 0 : 2) : (tNext.y < tNext.z ? 1 : 2);
+        cell[axis] += step[axis];
+        if (cell[axis] < 0 || cell[axis] >= resolution[axis]) {
+            break;
+        }
+        tCellEnter = tNext[axis];
+        tNext[axis] += tDelta[axis];
+        enteredAxis = axis;
+    }
+}
+
+Intersect UniformGrid::rayIntersect(const Ray& ray, Object*& hitObject, const Object* ignore,
+                                    const Object* ignoreOwner) const {
+    ClosestHit closest{ray, ignore, ignoreOwner};
+    Mailbox mailbox;
+
+    walk(ray, [&](uint32_t data, float tCellEnter, float tCellExit, int enteredAxis) {
+        if (tCellEnter > closest.ray.tMax) {
+            return true;
+        }
+        if (data & SOLID) {
+            uint32_t index = data & PAYLOAD;
+            if (enteredAxis < 0) {
+                // The ray starts here (or enters the grid here), let the cube decide
+                closest.test(objects[index], index);
+            } else if (objects[index] != ignore) {
+                Hit hit{true, tCellEnter, Cube::faceIndex(enteredAxis, ray.dirIsNeg[enteredAxis])};
+                closest.record(objects[index], index, hit);
+            }
+        } else if (data & LIST) {
+            const uint32_t* list = &lists[data & PAYLOAD];
+            for (uint32_t k = 1; k <= list[0]; k++) {
+                if (mailbox.visit(list[k])) {
+                    closest.test(objects[list[k]], list[k]);
+                }
+            }
+        }
+
+        // Every hit closer than the exit of this cell lies in a cell already visited
+        return closest.ray.tMax <= tCellExit;
+    });
+
+    hitObject = closest.object;
+    return closest.finalize();
+}
+
+bool UniformGrid::occluded(const Ray& ray, const Object*& occluder, const Object* ignore,
+                           const Object* ignoreOwner) const {
+    AnyHit anyHit{ray, ignore, ignoreOwner};
+    Mailbox mailbox;
+    bool hit = false;
+
+    walk(ray, [&](uint32_t data, float tCellEnter, float tCellExit, int enteredAxis) {
+        if (tCellEnter >= ray.tMax) {
+            return true;
+        }
+        if (data & SOLID) {
+            const Object* object = objects[data & PAYLOAD];
+            if (enteredAxis < 0) {
+                hit = anyHit.test(object);
+            } else if (object != ignore && tCellEnter > ray.tMin) {
+                // Entered through a face before tMax, no need to ask the cube
+                anyHit.occluder = object;
+                hit = true;
+            }
+        } else if (data & LIST) {
+            const uint32_t* list = &lists[data & PAYLOAD];
+            for (uint32_t k = 1; k <= list[0] && !hit; k++) {
+                hit = mailbox.visit(list[k]) && anyHit.test(objects[list[k]]);
+            }
+        }
+        return hit;
+    });
+
+    occluder = anyHit.occluder;
+    return hit;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "glm/glm.hpp"
+#include "aabb.h"
+#include "accelerator.h"
+#include "intersect.h"
+#include "object.h"
+
+// Dense uniform grid walked with the Amanatides-Woo 3D-DDA. Cells are aligned to
+// integer coordinates (doubled in size until the grid fits in MAX_CELLS), so a
+// unit cube placed on integer coordinates fills exactly one cell. Such "solid"
+// cells are hit at the moment the ray enters them without calling Cube::hit;
+// every other cell keeps a list of the objects overlapping it and tests them
+// with the exact Object::hit.
+class UniformGrid : public Accelerator {
+public:
+    void build(const std::vector<Object*>& sceneObjects) override;
+
+    Intersect rayIntersect(const Ray& ray, Object*& hitObject, const Object* ignore = nullptr,
+                           const Object* ignoreOwner = nullptr) const override;
+
+    bool occluded(const Ray& ray, const Object*& occluder, const Object* ignore = nullptr,
+                  const Object* ignoreOwner = nullptr) const override;
+
+    size_t getMemoryUsage() const override;
+
+    std::string getName() const override {
+        return "grid";
+    }
+
+private:
+    static const uint32_t EMPTY = 0;
+    static const uint32_t SOLID = 1u << 31;    // low bits: object index
+    static const uint32_t LIST = 1u << 30;     // low bits: offset in `lists` (count, then object indices)
+    static const uint32_t PAYLOAD = LIST - 1;
+    static const size_t MAX_CELLS = 1 << 24;
+
+    int cellIndex(int x, int y, int z) const {
+        return (z * resolution.y + y) * resolution.x + x;
+    }
+
+    // Visits the cells along the ray in order: visit(cell, tEnter, tExit, enteredAxis)
+    // gets -1 as the axis for the first cell and returns true to stop the walk
+    template <typename CellVisitor>
+    void walk(const Ray& ray, CellVisitor&& visit) const;
+
+    AABB bounds;
+    glm::vec3 origin;
+    float cellSize = 1.0f;
+    glm::ivec3 resolution = glm::ivec3(0);
+    std::vector<uint32_t> cells;
+    std::vector<uint32_t> lists;
+};
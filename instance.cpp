@@ -0,0 +1,80 @@
+#include "instance.h"
+#include "accelerator.h"
+
+Prefab::Prefab(const std::vector<Object*>& objects) : objects(objects) {
+    bvh.build(objects);
+    for (const auto& object : objects) {
+        bounds.expand(object->getBounds());
+    }
+}
+
+const uint8_t Instance::KIND = registerObjectKind<Instance>();
+
+Instance::Instance(const Prefab* prefab, const glm::mat4& transform) : Object(0, KIND), prefab(prefab) {
+    hasParts = true;
+    setTransform(transform);
+}
+
+void Instance::setTransform(const glm::mat4& transform) {
+    toLocal = glm::inverse(transform);
+    bounds = AABB();
+    if (!prefab->getObjects().empty()) {
+        const AABB& local = prefab->getBounds();
+        for (int i = 0; i < 8; i++) {
+            glm::vec3 corner((i & 1) ? local.max.x : local.min.x,
+                             (i & 2) ? local.max.y : local.min.y,
+                             (i & 4) ? local.max.z : local.min.z);
+            bounds.expand(glm::vec3(transform * glm::vec4(corner, 1.0f)));
+        }
+    }
+}
+
+Ray Instance::toLocalRay(const Ray& ray) const {
+    // The direction is not normalized, so distances along the ray are the same in both spaces
+    return Ray(glm::vec3(toLocal * glm::vec4(ray.origin, 1.0f)), glm::vec3(toLocal * glm::vec4(ray.direction, 0.0f)),
+               ray.tMin, ray.tMax);
+}
+
+Hit Instance::hit(const Ray& ray) const {
+    Object* part;
+    return hitParts(ray, part, nullptr);
+}
+
+// The accelerators go through hitParts, this only serves Object::rayIntersect
+Intersect Instance::finalize(const Ray& ray, const Hit& hit) const {
+    Object* part;
+    Hit partHit = hitParts(ray, part, nullptr);
+    return finalizeParts(ray, part, partHit);
+}
+
+Hit Instance::hitParts(const Ray& ray, Object*& part, const Object* ignore) const {
+    ClosestHit closest{toLocalRay(ray), ignore};
+    prefab->getBVH().findClosest(closest);
+
+    part = closest.object;
+    return closest.hit;
+}
+
+Intersect Instance::finalizeParts(const Ray& ray, const Object* part, const Hit& hit) const {
+    if (!part || !hit.isIntersecting) {
+        return Intersect{false};
+    }
+
+    Intersect intersect = objectKind(part).finalize(*part, toLocalRay(ray), hit);
+    intersect.point = ray.origin + intersect.dist * ray.direction;
+    intersect.normal = glm::normalize(glm::transpose(glm::mat3(toLocal)) * intersect.normal);
+    return intersect;
+}
+
+bool Instance::occluded(const Ray& ray) const {
+    return occludedParts(ray, nullptr);
+}
+
+bool Instance::occludedParts(const Ray& ray, const Object* ignore) const {
+    const Object* occluder;
+    return prefab->getBVH().occluded(toLocalRay(ray), occluder, ignore);
+}
+
+AABB Instance::getBounds() const {
+    return bounds;
+}
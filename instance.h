@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+#include "glm/glm.hpp"
+#include "aabb.h"
+#include "bvh.h"
+#include "intersect.h"
+#include "object.h"
+
+// A group of objects with its own BVH, built once and shared by every Instance
+// placing it in the scene
+class Prefab {
+public:
+    Prefab(const std::vector<Object*>& objects);
+
+    const std::vector<Object*>& getObjects() const {
+        return objects;
+    }
+
+    const BVH& getBVH() const {
+        return bvh;
+    }
+
+    const AABB& getBounds() const {
+        return bounds;
+    }
+
+    // Bytes of the prefab's BVH, the objects are counted by the caller
+    size_t getMemoryUsage() const {
+        return bvh.getMemoryUsage();
+    }
+
+private:
+    std::vector<Object*> objects;
+    BVH bvh;
+    AABB bounds;
+};
+
+// A prefab placed with an affine transform. The scene accelerator only sees the
+// instance bounds (top level); rays reaching one are moved into prefab space and
+// traced through the prefab BVH (bottom level). Hits report the prefab object
+// and the instance as Intersect::owner; a ray ignoring a part skips it only in
+// the instance passed as its owner.
+// Prefabs hold plain objects: a hit on a part is finalized by that part alone.
+class Instance : public Object {
+public:
+    static const uint8_t KIND;
+
+    Instance(const Prefab* prefab, const glm::mat4& transform);
+
+    Hit hit(const Ray& ray) const override;
+    Intersect finalize(const Ray& ray, const Hit& hit) const override;
+    Hit hitParts(const Ray& ray, Object*& part, const Object* ignore) const override;
+    Intersect finalizeParts(const Ray& ray, const Object* part, const Hit& hit) const override;
+    bool occluded(const Ray& ray) const override;
+    bool occludedParts(const Ray& ray, const Object* ignore) const override;
+    AABB getBounds() const override;
+
+    // Moves the instance; call Accelerator::refit before tracing again
+    void setTransform(const glm::mat4& transform);
+
+private:
+    // The ray in prefab space, with the same interval
+    Ray toLocalRay(const Ray& ray) const;
+
+    const Prefab* prefab;
+    glm::mat4 toLocal;
+    AABB bounds;
+};
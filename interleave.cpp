@@ -0,0 +1,35 @@
+#include "interleave.h"
+#include <cmath>
+
+namespace {
+
+// Thresholds of the 8x8 ordered dither, consecutive ranks far apart
+const uint8_t BAYER[8][8] = {
+    { 0, 32,  8, 40,  2, 34, 10, 42},
+    {48, 16, 56, 24, 50, 18, 58, 26},
+    {12, 44,  4, 36, 14, 46,  6, 38},
+    {60, 28, 52, 20, 62, 30, 54, 22},
+    { 3, 35, 11, 43,  1, 33,  9, 41},
+    {51, 19, 59, 27, 49, 17, 57, 25},
+    {15, 47,  7, 39, 13, 45,  5, 37},
+    {63, 31, 55, 23, 61, 29, 53, 21},
+};
+
+// Jimenez's interleaved gradient noise, in [0, 1)
+float gradientNoise(int x, int y) {
+    float value = 0.06711056f * x + 0.00583715f * y;
+    value = 52.9829189f * (value - std::floor(value));
+    return value - std::floor(value);
+}
+
+}
+
+Interleave::Interleave(int width, int height, int count, const std::string& pattern)
+        : width(width), count(count), classes(width * height) {
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int rank = pattern == "noise" ? static_cast<int>(gradientNoise(x, y) * 64) : BAYER[y % 8][x % 8];
+            classes[y * width + x] = static_cast<uint8_t>(rank * count / 64);
+        }
+    }
+}
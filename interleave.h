@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The pixels rendered by each frame when every pixel is refreshed once every
+// `count` frames; the others keep what the previous frame showed. Pixels are
+// split into `count` classes, rendered in turn, by an 8x8 Bayer matrix or by
+// interleaved gradient noise, which spreads them like blue noise.
+class Interleave {
+public:
+    // pattern is "bayer" or "noise"
+    Interleave(int width, int height, int count, const std::string& pattern);
+
+    int getCount() const {
+        return count;
+    }
+
+    // Whether the current frame leaves pixels to the history
+    bool isPartial() const {
+        return phase >= 0 && count > 1;
+    }
+
+    bool isRendered(int x, int y) const {
+        return phase < 0 || classes[y * width + x] == phase;
+    }
+
+    // Moves to the next class of pixels
+    void advance() {
+        phase = (phase + 1) % count;
+    }
+
+    // The next frame renders every pixel, when there is no history to keep
+    void reset() {
+        phase = -1;
+    }
+
+private:
+    int width;
+    int count;
+    int phase = -1;
+    std::vector<uint8_t> classes;   // frame of the cycle in which each pixel is rendered
+};
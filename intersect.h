@@ -1,10 +1,23 @@
 #pragma once
 
+#include <cstdint>
 #include "glm/glm.hpp"
 
+class Object;
+
+// Distance-only result of Object::hit, enough to pick the closest candidate.
+// Only the winner is turned into an Intersect, by Object::finalize.
+struct Hit {
+    bool isIntersecting = false;
+    float dist = 0.0f;
+    uint8_t face = 0;   // which face of the object, meaning depends on the object
+};
+
 struct Intersect {
     bool isIntersecting = false;
     float dist = 0.0f;
     glm::vec3 point;
     glm::vec3 normal;
-};
\ No newline at end of file
+    glm::vec2 uv;       // position on the face (cubes) or surface (spheres), in [0, 1]
+    const Object* owner = nullptr;  // the instance the hit object is a part of, if any
+};
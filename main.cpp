@@ -12,22 +12,67 @@
 #include "color.h"
 #include "intersect.h"
 #include "object.h"
+#include "arena.h"
 #include "sphere.h"
 #include "cube.h"
+#include "instance.h"
+#include "scenecompiler.h"
 #include "light.h"
 #include "camera.h"
+#include "accelerator.h"
+#include "options.h"
+#include "stats.h"
+#include "visibility.h"
+#include "renderpool.h"
+#include "framepipeline.h"
+#include "interleave.h"
+#include "reprojection.h"
 #include "glm/ext/matrix_transform.hpp"
 #include "SDL_image.h"
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
 
 const int SCREEN_WIDTH = 800;
 const int SCREEN_HEIGHT = 600;
-const float ASPECT_RATIO = static_cast<float>(SCREEN_WIDTH) / static_cast<float>(SCREEN_HEIGHT);
-const int MAX_RECURSION = 3;
+const int MAX_DEPTH = 16;               // upper bound of --depth
+const int MAX_PASS_THROUGH = 32;        // surfaces a ray crosses unbent before it is given the sky color
 const float BIAS = 0.0001f;
+const float SHADOW_INTENSITY = 0.3f;    // light left on occluded points, there is no ambient term
+const float FOV = 3.1415f / 3.0f;
+const int BLOCK_SIZE = 4;               // pixels shaded together, their rays are traced as packets
+// Pixels per side of the tiles handed to the render threads. Tile rows start
+// 128 bytes apart in the framebuffer, whose rows are whole cache lines, so no two
+// threads ever write to the same line.
+const int TILE_SIZE = 32;
+const int TILES_X = (SCREEN_WIDTH + TILE_SIZE - 1) / TILE_SIZE;
+const int TILES_Y = (SCREEN_HEIGHT + TILE_SIZE - 1) / TILE_SIZE;
+const float ADAPTIVE_NORMAL_TOLERANCE = 0.99f;  // cosine of the largest angle between the normals of an interpolated block
+const int PRESENT_WAIT_MS = 4;          // longest the main thread waits for a frame before polling events again
+const int ADAPTIVE_CHECK_PERIOD = 16;   // with --check-adaptive, one frame in this many is rendered in full too, to compare
 
 SDL_Renderer* renderer;
+SceneArena arena;                       // owns every object of the scene
+size_t droppedObjects = 0;              // left in the arena by compileScene, no longer part of the scene
+std::vector<std::unique_ptr<Prefab>> prefabs;   // shared by the instances in the arena
 std::vector<Object*> objects;
+Options options;
+Accelerator* accelerator = nullptr;
+RenderPool* renderPool = nullptr;
+FramePipeline* pipeline = nullptr;
+Interleave* interleave = nullptr;       // pixels each frame renders, used by the render thread only
+ReprojectionCache* reprojection = nullptr;  // with --reproject on a still scene
+Framebuffer* fullFrame = nullptr;           // with --check-adaptive, the frames rendered in full to compare against
+std::vector<Sphere*> movingSpheres;
+std::vector<Cube*> movingCubes;
+glm::vec3 orbitCenter;
+float orbitRadius;
 Camera camera(glm::vec3(0.0, 0.0, 15.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), 2.0f);
+std::mutex cameraMutex;                 // camera is moved by the main thread and copied by the render thread
+VisibilityBuffer visibility(SCREEN_WIDTH, SCREEN_HEIGHT, FOV);
 Skybox skybox("../texturas/fondo.png");
 Light light(
         glm::vec3(-20.0, -30, 30),   // Posición de la luz
@@ -37,365 +82,918 @@ Light light(
 
 
 
-void point(glm::vec2 position, Color color) {
-    SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
-    SDL_RenderDrawPoint(renderer, position.x, position.y);
-}
+float castShadow(const glm::vec3& shadowOrigin, const glm::vec3& lightDir, const Object* hitObject,
+                 const Object* hitOwner) {
+    stats.shadowRays++;
+    std::chrono::steady_clock::time_point start;
+    if (options.timeShadows) {
+        start = std::chrono::steady_clock::now();
+    }
 
-float castShadow(const glm::vec3& shadowOrigin, const glm::vec3& lightDir, Object* hitObject) {
-    for (auto& obj : objects) {
-        if (obj != hitObject) {
-            Intersect shadowIntersect = obj->rayIntersect(shadowOrigin, lightDir);
-            if (shadowIntersect.isIntersecting && shadowIntersect.dist > 0) {
-                float shadowRatio = shadowIntersect.dist / glm::length(light.position - shadowOrigin);
-                shadowRatio = glm::min(1.0f, shadowRatio);
-                return 1.0f - shadowRatio;
-            }
-        }
+    // Any occluder between the point and the light, the surface itself excluded:
+    // `hitObject`, in the `hitOwner` instance only when it is a part of one.
+    // Neighbouring shadow rays are usually blocked by the same object, so each
+    // render thread tries the last occluder it found before any traversal.
+    thread_local const Object* lastOccluder = nullptr;
+    Ray shadowRay(shadowOrigin, lightDir, 0.0f, glm::length(light.position - shadowOrigin));
+    AnyHit cached{shadowRay, hitObject, hitOwner};
+    bool occluded = lastOccluder != nullptr && cached.test(lastOccluder);
+    if (occluded) {
+        stats.shadowCacheHits++;
+    } else {
+        // Lit points clear the cache, so lit regions do not pay for a useless test
+        const Object* occluder;
+        occluded = accelerator->occluded(shadowRay, occluder, hitObject, hitOwner);
+        lastOccluder = occluded ? occluder : nullptr;
+    }
+
+    if (options.timeShadows) {
+        stats.shadowNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
     }
-    return 1.0f;
+    return occluded ? SHADOW_INTENSITY : 1.0f;
 }
 
-Color castRay(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, const short recursion = 0) {
-    float zBuffer = 99999;
-    Object* hitObject = nullptr;
+// Nearest hit of a ray traced before shading, e.g. as part of a packet
+struct TracedHit {
     Intersect intersect;
+    Object* object = nullptr;
+};
 
-    for (const auto& object : objects) {
-        Intersect i;
-        if (dynamic_cast<Cube*>(object) != nullptr) {
-            i = dynamic_cast<Cube*>(object)->rayIntersect(rayOrigin, rayDirection);
-        } else if (dynamic_cast<Sphere*>(object) != nullptr) {
-            i = dynamic_cast<Sphere*>(object)->rayIntersect(rayOrigin, rayDirection);
-        }
-        if (i.isIntersecting && i.dist < zBuffer) {
-            zBuffer = i.dist;
-            hitObject = object;
-            intersect = i;
-        }
-    }
+// Mirror ray cast from a reflective surface, along the reflected light direction
+void reflectionRay(const Intersect& intersect, glm::vec3& origin, glm::vec3& direction) {
+    glm::vec3 lightDir = glm::normalize(light.position - intersect.point);
+    origin = intersect.point + intersect.normal * BIAS;
+    direction = glm::reflect(-lightDir, intersect.normal);
+}
 
-    if (!intersect.isIntersecting || recursion == MAX_RECURSION) {
-        return skybox.getColor(rayDirection);  // Sky color
+// A ray of the tree below one pixel, waiting to be traced and shaded
+struct PathRay {
+    glm::vec3 origin;
+    glm::vec3 direction;
+    float weight;                               // share of its color in the pixel
+    int depth;                                  // 0 for the primary ray
+    const TracedHit* hit = nullptr;             // nearest hit, when already traced
+    const TracedHit* reflection = nullptr;      // nearest hit of its reflection ray, when already traced
+};
+
+// Rays of one pixel left to shade, taken depth first. A level leaves one
+// sibling waiting per surface crossed, so a full stack culls the ray instead.
+struct RayStack {
+    static const int CAPACITY = 64;
+    PathRay rays[CAPACITY];
+    int size = 0;
+};
+
+// Queues a reflection or refraction ray, unless its weight is too small to
+// change the pixel. With --roulette, lighter rays survive at random with a
+// probability proportional to their weight and are given the roulette weight,
+// which keeps the expected color.
+void pushBranch(RayStack& stack, const PathRay& ray) {
+    if (ray.weight < options.minWeight || stack.size == RayStack::CAPACITY) {
+        stats.culledRays++;
+        return;
     }
 
+    PathRay branch = ray;
+    if (ray.weight < options.roulette) {
+        thread_local std::minstd_rand random(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        if (std::uniform_real_distribution<float>(0.0f, 1.0f)(random) * options.roulette >= ray.weight) {
+            stats.culledRays++;
+            return;
+        }
+        branch.weight = options.roulette;
+    }
+    stack.rays[stack.size++] = branch;
+}
 
-    glm::vec3 lightDir = glm::normalize(light.position - intersect.point);
-    glm::vec3 viewDir = glm::normalize(rayOrigin - intersect.point);
-    glm::vec3 reflectDir = glm::reflect(-lightDir, intersect.normal);
+// Shading of a hit on a material made of the Terms (ShadingTerm bits): the
+// direct light is added to the pixel and the reflection and refraction rays are
+// queued with their weight. Terms the material lacks are left out at compile time.
+template <uint8_t Terms>
+void shadeSurface(const PathRay& ray, const Intersect& intersect, Object* hitObject, const Material& mat,
+                  RayStack& stack, glm::vec3& pixel) {
+    if constexpr ((Terms & SHADE_LIT) != 0) {
+        glm::vec3 lightDir = glm::normalize(light.position - intersect.point);
+        glm::vec3 viewDir = glm::normalize(ray.origin - intersect.point);
+        glm::vec3 reflectDir = glm::reflect(-lightDir, intersect.normal);
+
+        float shadowIntensity = castShadow(intersect.point, lightDir, hitObject, intersect.owner);
+
+        float diffuseLightIntensity = std::max(0.0f, glm::dot(intersect.normal, lightDir));
+        float specLightIntensity = specularFalloff(mat, std::max(0.0f, glm::dot(viewDir, reflectDir)));
+
+        Color diffuseLight = mat.diffuse * light.intensity * diffuseLightIntensity * mat.albedo * shadowIntensity;
+        Color specularLight = light.color * light.intensity * specLightIntensity * mat.specularAlbedo * shadowIntensity;
+        Color color = (diffuseLight + specularLight) * (1.0f - mat.reflectivity - mat.transparency);
+        pixel += ray.weight * glm::vec3(color.r, color.g, color.b);
+    }
 
-    float shadowIntensity = castShadow(intersect.point, lightDir, hitObject);
+    if constexpr ((Terms & SHADE_REFLECT) != 0) {
+        glm::vec3 origin, direction;
+        reflectionRay(intersect, origin, direction);
+        pushBranch(stack, {origin, direction, ray.weight * mat.reflectivity, ray.depth + 1, ray.reflection});
+    }
 
-    float diffuseLightIntensity = std::max(0.0f, glm::dot(intersect.normal, lightDir));
-    float specReflection = glm::dot(viewDir, reflectDir);
+    if constexpr ((Terms & SHADE_REFRACT) != 0) {
+        // glm::refract gives a zero direction on total internal reflection, there is nothing to trace then
+        glm::vec3 refractDir = glm::refract(ray.direction, intersect.normal, mat.refractionIndex);
+        if (refractDir != glm::vec3(0.0f)) {
+            glm::vec3 origin = intersect.point - intersect.normal * BIAS;
+            pushBranch(stack, {origin, refractDir, ray.weight * mat.transparency, ray.depth + 1});
+        }
+    }
+}
 
-    Material mat = hitObject->material;
+typedef void (*ShadeKernel)(const PathRay&, const Intersect&, Object*, const Material&, RayStack&, glm::vec3&);
+
+// Indexed by the SHADE_KERNEL_TERMS of Material::shading
+const uint8_t SHADE_KERNEL_TERMS = SHADE_LIT | SHADE_REFLECT | SHADE_REFRACT;
+const ShadeKernel shadeKernels[8] = {
+        shadeSurface<0>, shadeSurface<1>, shadeSurface<2>, shadeSurface<3>,
+        shadeSurface<4>, shadeSurface<5>, shadeSurface<6>, shadeSurface<7>,
+};
+
+// Color of a pixel: the rays below `primary` are traced and shaded one at a
+// time from a stack, each adding its direct light times its weight. Rays at
+// options.maxDepth take the sky color without being traced.
+Color shade(const PathRay& primary) {
+    RayStack stack;
+    stack.rays[stack.size++] = primary;
+    glm::vec3 pixel(0.0f);
+
+    while (stack.size > 0) {
+        PathRay ray = stack.rays[--stack.size];
+        // Surfaces that do not bend the ray (SHADE_PASS) are crossed by tracing the
+        // same ray again past them, at the same depth
+        float tMin = -std::numeric_limits<float>::max();
+        for (int surfaces = 0;; surfaces++) {
+            bool traced = ray.depth < options.maxDepth && surfaces < MAX_PASS_THROUGH;
+            TracedHit nearest;
+            if (!ray.hit && traced) {
+                stats.rays++;
+                nearest.intersect = accelerator->rayIntersect(Ray(ray.origin, ray.direction, tMin), nearest.object);
+                ray.hit = &nearest;
+            }
 
-    float specLightIntensity = std::pow(std::max(0.0f, glm::dot(viewDir, reflectDir)), mat.specularCoefficient);
+            if (!traced || !ray.hit->intersect.isIntersecting) {
+                Color sky = skybox.getColor(ray.direction);
+                pixel += ray.weight * glm::vec3(sky.r, sky.g, sky.b);
+                break;
+            }
 
-    Color reflectedColor(0.0f, 0.0f, 0.0f);
-    if (mat.reflectivity > 0) {
-        glm::vec3 origin = intersect.point + intersect.normal * BIAS;
-        reflectedColor = castRay(origin, reflectDir, recursion + 1);
-    }
+            Object* hitObject = ray.hit->object;
+            const Material& mat = materials[hitObject->material];
+            shadeKernels[mat.shading & SHADE_KERNEL_TERMS](ray, ray.hit->intersect, hitObject, mat, stack, pixel);
+            if (!(mat.shading & SHADE_PASS)) {
+                break;
+            }
 
-    Color refractedColor(0.0f, 0.0f, 0.0f);
-    if (mat.transparency > 0) {
-        glm::vec3 origin = intersect.point - intersect.normal * BIAS;
-        glm::vec3 refractDir = glm::refract(rayDirection, intersect.normal, mat.refractionIndex);
-        refractedColor = castRay(origin, refractDir, recursion + 1);
+            ray.weight *= mat.transparency;
+            if (ray.weight < options.minWeight) {
+                stats.culledRays++;
+                break;
+            }
+            stats.passThroughs++;
+            tMin = ray.hit->intersect.dist;
+            ray.hit = nullptr;
+            ray.reflection = nullptr;
+        }
     }
 
-    Color diffuseLight = mat.diffuse * light.intensity * diffuseLightIntensity * mat.albedo * shadowIntensity;
-    Color specularLight = light.color * light.intensity * specLightIntensity * mat.specularAlbedo * shadowIntensity;
-    Color color = (diffuseLight + specularLight) * (1.0f - mat.reflectivity - mat.transparency) + reflectedColor * mat.reflectivity + refractedColor * mat.transparency;
-    return color;
+    pixel = glm::min(pixel, glm::vec3(255.0f));
+    return Color(static_cast<int>(pixel.r), static_cast<int>(pixel.g), static_cast<int>(pixel.b));
 }
 
 void setUp() {
     // Nuevos materiales para roca
-    Material metal1 = {Color(60, 65, 83), 0.8, 0.2, 10.0f, 0.0f, 0.0f};
-    Material metal2 = {Color(51, 56, 68), 0.8, 0.2, 10.0f, 0.0f, 0.0f};
+    uint16_t metal1 = addMaterial({Color(60, 65, 83), 0.8, 0.2, 10.0f, 0.0f, 0.0f});
+    uint16_t metal2 = addMaterial({Color(51, 56, 68), 0.8, 0.2, 10.0f, 0.0f, 0.0f});
 
-    Material madera1 = {Color(114, 67, 40), 0.6, 0.4, 20.0f, 0.0f, 0.0f};
-    Material madera2 = {Color(105, 52, 29), 0.6, 0.4, 20.0f, 0.0f, 0.0f};
+    uint16_t madera1 = addMaterial({Color(114, 67, 40), 0.6, 0.4, 20.0f, 0.0f, 0.0f});
+    uint16_t madera2 = addMaterial({Color(105, 52, 29), 0.6, 0.4, 20.0f, 0.0f, 0.0f});
 
-    Material luz1 = {Color(255, 180, 0, 225), 0.0, 0.0, 5.0f, 0.8f, 1.0f};
-    Material luz2 = {Color(255, 150, 0, 225), 0.0, 0.0, 5.0f, 0.8f, 1.0f};
-    Material luz3 = {Color(255, 120, 0, 225), 0.0, 0.0, 5.0f, 0.8f, 1.0f};
-    Material luz4 = {Color(255, 90, 0, 225), 0.0, 0.0, 5.0f, 0.8f, 1.0f};
-    Material luz5 = {Color(255, 60, 0, 225), 0.0, 0.0, 5.0f, 0.8f, 1.0f};
+    uint16_t luz1 = addMaterial({Color(255, 180, 0, 225), 0.0, 0.0, 5.0f, 0.8f, 1.0f, 1.0f});
+    uint16_t luz2 = addMaterial({Color(255, 150, 0, 225), 0.0, 0.0, 5.0f, 0.8f, 1.0f, 1.0f});
+    uint16_t luz3 = addMaterial({Color(255, 120, 0, 225), 0.0, 0.0, 5.0f, 0.8f, 1.0f, 1.0f});
+    uint16_t luz4 = addMaterial({Color(255, 90, 0, 225), 0.0, 0.0, 5.0f, 0.8f, 1.0f, 1.0f});
+    uint16_t luz5 = addMaterial({Color(255, 60, 0, 225), 0.0, 0.0, 5.0f, 0.8f, 1.0f, 1.0f});
 
     //suelo1
-    objects.push_back(new Cube(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
-    objects.push_back(new Cube(glm::vec3(2.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(3.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(4.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(5.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(6.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
-
-    objects.push_back(new Cube(glm::vec3(0.0f, 0.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(0.0f, 0.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(0.0f, 0.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
-
-    objects.push_back(new Cube(glm::vec3(6.0f, 0.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(6.0f, 0.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(6.0f, 0.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(6.0f, 0.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(6.0f, 0.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
-
-    objects.push_back(new Cube(glm::vec3(2.0f, 0.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(3.0f, 0.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(4.0f, 0.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(5.0f, 0.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(6.0f, 0.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
+    objects.push_back(arena.create<Cube>(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
+    objects.push_back(arena.create<Cube>(glm::vec3(2.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(3.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(4.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(5.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
+
+    objects.push_back(arena.create<Cube>(glm::vec3(0.0f, 0.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(0.0f, 0.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(0.0f, 0.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
+
+    objects.push_back(arena.create<Cube>(glm::vec3(6.0f, 0.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.0f, 0.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.0f, 0.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.0f, 0.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.0f, 0.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
+
+    objects.push_back(arena.create<Cube>(glm::vec3(2.0f, 0.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(3.0f, 0.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(4.0f, 0.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(5.0f, 0.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.0f, 0.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
 
 
     //columna1
-    objects.push_back(new Cube(glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
-    objects.push_back(new Cube(glm::vec3(0.0f, 3.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
-    objects.push_back(new Cube(glm::vec3(0.0f, 4.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
-    objects.push_back(new Cube(glm::vec3(0.0f, 5.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
-    objects.push_back(new Cube(glm::vec3(0.0f, 6.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
+    objects.push_back(arena.create<Cube>(glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
+    objects.push_back(arena.create<Cube>(glm::vec3(0.0f, 3.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
+    objects.push_back(arena.create<Cube>(glm::vec3(0.0f, 4.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
+    objects.push_back(arena.create<Cube>(glm::vec3(0.0f, 5.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
+    objects.push_back(arena.create<Cube>(glm::vec3(0.0f, 6.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
     //columna2
-    objects.push_back(new Cube(glm::vec3(6.0f, 2.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
-    objects.push_back(new Cube(glm::vec3(6.0f, 3.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
-    objects.push_back(new Cube(glm::vec3(6.0f, 4.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
-    objects.push_back(new Cube(glm::vec3(6.0f, 5.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
-    objects.push_back(new Cube(glm::vec3(6.0f, 6.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.0f, 2.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.0f, 3.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.0f, 4.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.0f, 5.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.0f, 6.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
     //columna3
-    objects.push_back(new Cube(glm::vec3(0.0f, 2.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
-    objects.push_back(new Cube(glm::vec3(0.0f, 3.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
-    objects.push_back(new Cube(glm::vec3(0.0f, 4.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
-    objects.push_back(new Cube(glm::vec3(0.0f, 5.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
-    objects.push_back(new Cube(glm::vec3(0.0f, 6.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
+    objects.push_back(arena.create<Cube>(glm::vec3(0.0f, 2.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
+    objects.push_back(arena.create<Cube>(glm::vec3(0.0f, 3.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
+    objects.push_back(arena.create<Cube>(glm::vec3(0.0f, 4.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
+    objects.push_back(arena.create<Cube>(glm::vec3(0.0f, 5.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
+    objects.push_back(arena.create<Cube>(glm::vec3(0.0f, 6.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
     //columna4
-    objects.push_back(new Cube(glm::vec3(6.0f, 2.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
-    objects.push_back(new Cube(glm::vec3(6.0f, 3.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
-    objects.push_back(new Cube(glm::vec3(6.0f, 4.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
-    objects.push_back(new Cube(glm::vec3(6.0f, 5.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
-    objects.push_back(new Cube(glm::vec3(6.0f, 6.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.0f, 2.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.0f, 3.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.0f, 4.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.0f, 5.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.0f, 6.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
 
 
 
     //cara1
-    objects.push_back(new Cube(glm::vec3(2.0f, 2.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
-    objects.push_back(new Cube(glm::vec3(3.0f, 2.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
-    objects.push_back(new Cube(glm::vec3(4.0f, 2.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
-    objects.push_back(new Cube(glm::vec3(5.0f, 2.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
+    objects.push_back(arena.create<Cube>(glm::vec3(2.0f, 2.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
+    objects.push_back(arena.create<Cube>(glm::vec3(3.0f, 2.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(4.0f, 2.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(5.0f, 2.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
 
-    objects.push_back(new Cube(glm::vec3(2.0f, 3.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
-    objects.push_back(new Cube(glm::vec3(3.0f, 3.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz2));
-    objects.push_back(new Cube(glm::vec3(4.0f, 3.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz1));
-    objects.push_back(new Cube(glm::vec3(5.0f, 3.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(2.0f, 3.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(3.0f, 3.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz2));
+    objects.push_back(arena.create<Cube>(glm::vec3(4.0f, 3.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz1));
+    objects.push_back(arena.create<Cube>(glm::vec3(5.0f, 3.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
 
-    objects.push_back(new Cube(glm::vec3(2.0f, 4.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
-    objects.push_back(new Cube(glm::vec3(3.0f, 4.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz1));
-    objects.push_back(new Cube(glm::vec3(4.0f, 4.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz2));
-    objects.push_back(new Cube(glm::vec3(5.0f, 4.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(2.0f, 4.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(3.0f, 4.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz1));
+    objects.push_back(arena.create<Cube>(glm::vec3(4.0f, 4.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz2));
+    objects.push_back(arena.create<Cube>(glm::vec3(5.0f, 4.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
 
-    objects.push_back(new Cube(glm::vec3(2.0f, 5.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
-    objects.push_back(new Cube(glm::vec3(3.0f, 5.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
-    objects.push_back(new Cube(glm::vec3(4.0f, 5.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
-    objects.push_back(new Cube(glm::vec3(5.0f, 5.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
+    objects.push_back(arena.create<Cube>(glm::vec3(2.0f, 5.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
+    objects.push_back(arena.create<Cube>(glm::vec3(3.0f, 5.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(4.0f, 5.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(5.0f, 5.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
 
-    objects.push_back(new Cube(glm::vec3(2.0f, 6.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz5));
-    objects.push_back(new Cube(glm::vec3(3.0f, 6.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
-    objects.push_back(new Cube(glm::vec3(4.0f, 6.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
-    objects.push_back(new Cube(glm::vec3(5.0f, 6.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz5));
+    objects.push_back(arena.create<Cube>(glm::vec3(2.0f, 6.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz5));
+    objects.push_back(arena.create<Cube>(glm::vec3(3.0f, 6.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
+    objects.push_back(arena.create<Cube>(glm::vec3(4.0f, 6.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
+    objects.push_back(arena.create<Cube>(glm::vec3(5.0f, 6.0f, -0.01f), glm::vec3(1.0f, 1.0f, 1.0f), luz5));
 
 
     //cara2
-    objects.push_back(new Cube(glm::vec3(2.0f, 2.0f, 6.1f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
-    objects.push_back(new Cube(glm::vec3(3.0f, 2.0f, 6.1f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
-    objects.push_back(new Cube(glm::vec3(4.0f, 2.0f, 6.1f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
-    objects.push_back(new Cube(glm::vec3(5.0f, 2.0f, 6.1f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
+    objects.push_back(arena.create<Cube>(glm::vec3(2.0f, 2.0f, 6.1f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
+    objects.push_back(arena.create<Cube>(glm::vec3(3.0f, 2.0f, 6.1f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(4.0f, 2.0f, 6.1f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(5.0f, 2.0f, 6.1f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
 
-    objects.push_back(new Cube(glm::vec3(2.0f, 3.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
-    objects.push_back(new Cube(glm::vec3(3.0f, 3.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz2));
-    objects.push_back(new Cube(glm::vec3(4.0f, 3.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz1));
-    objects.push_back(new Cube(glm::vec3(5.0f, 3.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(2.0f, 3.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(3.0f, 3.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz2));
+    objects.push_back(arena.create<Cube>(glm::vec3(4.0f, 3.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz1));
+    objects.push_back(arena.create<Cube>(glm::vec3(5.0f, 3.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
 
-    objects.push_back(new Cube(glm::vec3(2.0f, 4.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
-    objects.push_back(new Cube(glm::vec3(3.0f, 4.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz1));
-    objects.push_back(new Cube(glm::vec3(4.0f, 4.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz2));
-    objects.push_back(new Cube(glm::vec3(5.0f, 4.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(2.0f, 4.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(3.0f, 4.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz1));
+    objects.push_back(arena.create<Cube>(glm::vec3(4.0f, 4.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz2));
+    objects.push_back(arena.create<Cube>(glm::vec3(5.0f, 4.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
 
-    objects.push_back(new Cube(glm::vec3(2.0f, 5.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
-    objects.push_back(new Cube(glm::vec3(3.0f, 5.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
-    objects.push_back(new Cube(glm::vec3(4.0f, 5.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
-    objects.push_back(new Cube(glm::vec3(5.0f, 5.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
+    objects.push_back(arena.create<Cube>(glm::vec3(2.0f, 5.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
+    objects.push_back(arena.create<Cube>(glm::vec3(3.0f, 5.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(4.0f, 5.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(5.0f, 5.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
 
-    objects.push_back(new Cube(glm::vec3(2.0f, 6.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz5));
-    objects.push_back(new Cube(glm::vec3(3.0f, 6.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
-    objects.push_back(new Cube(glm::vec3(4.0f, 6.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
-    objects.push_back(new Cube(glm::vec3(5.0f, 6.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz5));
+    objects.push_back(arena.create<Cube>(glm::vec3(2.0f, 6.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz5));
+    objects.push_back(arena.create<Cube>(glm::vec3(3.0f, 6.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
+    objects.push_back(arena.create<Cube>(glm::vec3(4.0f, 6.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
+    objects.push_back(arena.create<Cube>(glm::vec3(5.0f, 6.0f, 6.1), glm::vec3(1.0f, 1.0f, 1.0f), luz5));
 
 
 
     //cara3
-    objects.push_back(new Cube(glm::vec3(6.1f, 2.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
-    objects.push_back(new Cube(glm::vec3(6.1f, 2.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
-    objects.push_back(new Cube(glm::vec3(6.1f, 2.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
-    objects.push_back(new Cube(glm::vec3(6.1f, 2.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.1f, 2.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.1f, 2.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.1f, 2.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.1f, 2.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
 
-    objects.push_back(new Cube(glm::vec3(6.1, 3.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
-    objects.push_back(new Cube(glm::vec3(6.1, 3.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz2));
-    objects.push_back(new Cube(glm::vec3(6.1, 3.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz1));
-    objects.push_back(new Cube(glm::vec3(6.1, 3.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.1, 3.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.1, 3.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz2));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.1, 3.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz1));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.1, 3.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
 
-    objects.push_back(new Cube(glm::vec3(6.1, 4.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
-    objects.push_back(new Cube(glm::vec3(6.1, 4.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz1));
-    objects.push_back(new Cube(glm::vec3(6.1, 4.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz2));
-    objects.push_back(new Cube(glm::vec3(6.1, 4.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.1, 4.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.1, 4.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz1));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.1, 4.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz2));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.1, 4.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
 
-    objects.push_back(new Cube(glm::vec3(6.1, 5.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
-    objects.push_back(new Cube(glm::vec3(6.1, 5.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
-    objects.push_back(new Cube(glm::vec3(6.1, 5.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
-    objects.push_back(new Cube(glm::vec3(6.1, 5.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.1, 5.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.1, 5.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.1, 5.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.1, 5.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
 
-    objects.push_back(new Cube(glm::vec3(6.1, 6.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz5));
-    objects.push_back(new Cube(glm::vec3(6.1, 6.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
-    objects.push_back(new Cube(glm::vec3(6.1, 6.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
-    objects.push_back(new Cube(glm::vec3(6.1, 6.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz5));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.1, 6.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz5));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.1, 6.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.1, 6.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.1, 6.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz5));
 
 
     //cara4
-    objects.push_back(new Cube(glm::vec3(-0.1f, 2.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
-    objects.push_back(new Cube(glm::vec3(-0.1f, 2.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
-    objects.push_back(new Cube(glm::vec3(-0.1f, 2.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
-    objects.push_back(new Cube(glm::vec3(-0.1f, 2.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
+    objects.push_back(arena.create<Cube>(glm::vec3(-0.1f, 2.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
+    objects.push_back(arena.create<Cube>(glm::vec3(-0.1f, 2.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(-0.1f, 2.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(-0.1f, 2.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
 
-    objects.push_back(new Cube(glm::vec3(-0.1, 3.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
-    objects.push_back(new Cube(glm::vec3(-0.1, 3.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz2));
-    objects.push_back(new Cube(glm::vec3(-0.1, 3.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz1));
-    objects.push_back(new Cube(glm::vec3(-0.1, 3.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(-0.1, 3.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(-0.1, 3.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz2));
+    objects.push_back(arena.create<Cube>(glm::vec3(-0.1, 3.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz1));
+    objects.push_back(arena.create<Cube>(glm::vec3(-0.1, 3.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
 
-    objects.push_back(new Cube(glm::vec3(-0.1, 4.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
-    objects.push_back(new Cube(glm::vec3(-0.1, 4.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz1));
-    objects.push_back(new Cube(glm::vec3(-0.1, 4.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz2));
-    objects.push_back(new Cube(glm::vec3(-0.1, 4.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(-0.1, 4.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(-0.1, 4.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz1));
+    objects.push_back(arena.create<Cube>(glm::vec3(-0.1, 4.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz2));
+    objects.push_back(arena.create<Cube>(glm::vec3(-0.1, 4.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
 
-    objects.push_back(new Cube(glm::vec3(-0.1, 5.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
-    objects.push_back(new Cube(glm::vec3(-0.1, 5.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
-    objects.push_back(new Cube(glm::vec3(-0.1, 5.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
-    objects.push_back(new Cube(glm::vec3(-0.1, 5.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
+    objects.push_back(arena.create<Cube>(glm::vec3(-0.1, 5.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
+    objects.push_back(arena.create<Cube>(glm::vec3(-0.1, 5.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(-0.1, 5.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz3));
+    objects.push_back(arena.create<Cube>(glm::vec3(-0.1, 5.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
 
-    objects.push_back(new Cube(glm::vec3(-0.1, 6.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz5));
-    objects.push_back(new Cube(glm::vec3(-0.1, 6.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
-    objects.push_back(new Cube(glm::vec3(-0.1, 6.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
-    objects.push_back(new Cube(glm::vec3(-0.1, 6.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz5));
+    objects.push_back(arena.create<Cube>(glm::vec3(-0.1, 6.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz5));
+    objects.push_back(arena.create<Cube>(glm::vec3(-0.1, 6.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
+    objects.push_back(arena.create<Cube>(glm::vec3(-0.1, 6.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz4));
+    objects.push_back(arena.create<Cube>(glm::vec3(-0.1, 6.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), luz5));
 
 
     //techo
-    objects.push_back(new Cube(glm::vec3(0.0f, 7.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
-    objects.push_back(new Cube(glm::vec3(2.0f, 7.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(3.0f, 7.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(4.0f, 7.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(5.0f, 7.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(6.0f, 7.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
-
-    objects.push_back(new Cube(glm::vec3(0.0f, 7.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(0.0f, 7.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(0.0f, 7.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(0.0f, 7.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(0.0f, 7.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
-
-    objects.push_back(new Cube(glm::vec3(6.0f, 7.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(6.0f, 7.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(6.0f, 7.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(6.0f, 7.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(6.0f, 7.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
-
-    objects.push_back(new Cube(glm::vec3(2.0f, 7.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(3.0f, 7.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(4.0f, 7.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(5.0f, 7.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(6.0f, 7.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
-
-
-    objects.push_back(new Cube(glm::vec3(2.0f, 8.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
-    objects.push_back(new Cube(glm::vec3(3.0f, 8.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
-    objects.push_back(new Cube(glm::vec3(4.0f, 8.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
-    objects.push_back(new Cube(glm::vec3(5.0f, 8.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
-
-    objects.push_back(new Cube(glm::vec3(2.0f, 8.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
-    objects.push_back(new Cube(glm::vec3(2.0f, 8.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
-    objects.push_back(new Cube(glm::vec3(2.0f, 8.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
-    objects.push_back(new Cube(glm::vec3(2.0f, 8.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
-
-    objects.push_back(new Cube(glm::vec3(5.0f, 8.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
-    objects.push_back(new Cube(glm::vec3(5.0f, 8.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
-    objects.push_back(new Cube(glm::vec3(5.0f, 8.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
-    objects.push_back(new Cube(glm::vec3(5.0f, 8.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
-
-    objects.push_back(new Cube(glm::vec3(2.0f, 8.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
-    objects.push_back(new Cube(glm::vec3(3.0f, 8.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
-    objects.push_back(new Cube(glm::vec3(4.0f, 8.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
-    objects.push_back(new Cube(glm::vec3(5.0f, 8.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
-
-
-
-    objects.push_back(new Cube(glm::vec3(2.0f, 9.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
-    objects.push_back(new Cube(glm::vec3(3.0f, 9.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(4.0f, 9.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(5.0f, 9.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
-
-    objects.push_back(new Cube(glm::vec3(2.0f, 9.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
-    objects.push_back(new Cube(glm::vec3(2.0f, 9.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(2.0f, 9.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(2.0f, 9.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
-
-    objects.push_back(new Cube(glm::vec3(5.0f, 9.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
-    objects.push_back(new Cube(glm::vec3(5.0f, 9.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(5.0f, 9.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(5.0f, 9.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
-
-    objects.push_back(new Cube(glm::vec3(2.0f, 9.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
-    objects.push_back(new Cube(glm::vec3(3.0f, 9.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(4.0f, 9.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
-    objects.push_back(new Cube(glm::vec3(5.0f, 9.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
+    objects.push_back(arena.create<Cube>(glm::vec3(0.0f, 7.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
+    objects.push_back(arena.create<Cube>(glm::vec3(2.0f, 7.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(3.0f, 7.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(4.0f, 7.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(5.0f, 7.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.0f, 7.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
+
+    objects.push_back(arena.create<Cube>(glm::vec3(0.0f, 7.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(0.0f, 7.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(0.0f, 7.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(0.0f, 7.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(0.0f, 7.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
+
+    objects.push_back(arena.create<Cube>(glm::vec3(6.0f, 7.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.0f, 7.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.0f, 7.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.0f, 7.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.0f, 7.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
+
+    objects.push_back(arena.create<Cube>(glm::vec3(2.0f, 7.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(3.0f, 7.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(4.0f, 7.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(5.0f, 7.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(6.0f, 7.0f, 6.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
+
+
+    objects.push_back(arena.create<Cube>(glm::vec3(2.0f, 8.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
+    objects.push_back(arena.create<Cube>(glm::vec3(3.0f, 8.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
+    objects.push_back(arena.create<Cube>(glm::vec3(4.0f, 8.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
+    objects.push_back(arena.create<Cube>(glm::vec3(5.0f, 8.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
+
+    objects.push_back(arena.create<Cube>(glm::vec3(2.0f, 8.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
+    objects.push_back(arena.create<Cube>(glm::vec3(2.0f, 8.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
+    objects.push_back(arena.create<Cube>(glm::vec3(2.0f, 8.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
+    objects.push_back(arena.create<Cube>(glm::vec3(2.0f, 8.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
+
+    objects.push_back(arena.create<Cube>(glm::vec3(5.0f, 8.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
+    objects.push_back(arena.create<Cube>(glm::vec3(5.0f, 8.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
+    objects.push_back(arena.create<Cube>(glm::vec3(5.0f, 8.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
+    objects.push_back(arena.create<Cube>(glm::vec3(5.0f, 8.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
+
+    objects.push_back(arena.create<Cube>(glm::vec3(2.0f, 8.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
+    objects.push_back(arena.create<Cube>(glm::vec3(3.0f, 8.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
+    objects.push_back(arena.create<Cube>(glm::vec3(4.0f, 8.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera1));
+    objects.push_back(arena.create<Cube>(glm::vec3(5.0f, 8.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), madera2));
+
+
+
+    objects.push_back(arena.create<Cube>(glm::vec3(2.0f, 9.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
+    objects.push_back(arena.create<Cube>(glm::vec3(3.0f, 9.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(4.0f, 9.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(5.0f, 9.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
+
+    objects.push_back(arena.create<Cube>(glm::vec3(2.0f, 9.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
+    objects.push_back(arena.create<Cube>(glm::vec3(2.0f, 9.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(2.0f, 9.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(2.0f, 9.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
+
+    objects.push_back(arena.create<Cube>(glm::vec3(5.0f, 9.0f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
+    objects.push_back(arena.create<Cube>(glm::vec3(5.0f, 9.0f, 3.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(5.0f, 9.0f, 4.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(5.0f, 9.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
+
+    objects.push_back(arena.create<Cube>(glm::vec3(2.0f, 9.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
+    objects.push_back(arena.create<Cube>(glm::vec3(3.0f, 9.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(4.0f, 9.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal1));
+    objects.push_back(arena.create<Cube>(glm::vec3(5.0f, 9.0f, 5.0f), glm::vec3(1.0f, 1.0f, 1.0f), metal2));
 
 }
 
-void render() {
-    float fov = 3.1415/3;
-    for (int y = 0; y < SCREEN_HEIGHT; y++) {
-        for (int x = 0; x < SCREEN_WIDTH; x++) {
+// Scene compilation pass run after loading, unless --compile off
+void compileObjects() {
+    if (options.compile == "off") {
+        return;
+    }
+    size_t before = objects.size();
+    size_t created = arena.getObjectCount();
+    objects = compileScene(objects, options.compile == "faces", arena);
+    created = arena.getObjectCount() - created;
+    // The objects not kept stay in the arena until it is cleared
+    droppedObjects += before - (objects.size() - created);
+    print("compiled objects:", before, "->", objects.size());
+}
+
+// Smooth height field for the blocks scene
+int blockHeight(int x, int z) {
+    return static_cast<int>(4.0f + 3.0f * std::sin(x * 0.21f) * std::cos(z * 0.17f) + 2.0f * std::sin((x + z) * 0.09f));
+}
+
+// Terrain of unit cubes, size x size columns centered below the camera, used to
+// compare the accelerators on scenes bigger than the lantern
+void setUpBlocks(int size) {
+    uint16_t grass = addMaterial({Color(74, 120, 52), 0.8, 0.2, 10.0f, 0.0f, 0.0f});
+    uint16_t dirt = addMaterial({Color(105, 52, 29), 0.6, 0.4, 20.0f, 0.0f, 0.0f});
+    uint16_t stone = addMaterial({Color(60, 65, 83), 0.8, 0.2, 10.0f, 0.0f, 0.0f});
+
+    for (int x = -size / 2; x < size / 2; x++) {
+        for (int z = -size / 2; z < size / 2; z++) {
+            int height = blockHeight(x, z);
+
+            // Only the cubes that stick out above a neighbouring column can be seen
+            int lowest = std::min({blockHeight(x - 1, z), blockHeight(x + 1, z), blockHeight(x, z - 1), blockHeight(x, z + 1)});
+            lowest = std::min(height, lowest + 1);
+
+            for (int y = lowest; y <= height; y++) {
+                uint16_t mat = y == height ? grass : (height - y < 3 ? dirt : stone);
+                glm::vec3 corner(x, y - 8, z);
+                objects.push_back(arena.create<Cube>(corner, corner + glm::vec3(1.0f), mat));
+            }
+        }
+    }
+}
+
+// size x size copies of the lantern sharing one prefab, each turned a bit more
+// than the previous one. Only the prefab holds cubes and a BVH.
+void setUpLanterns(int size) {
+    setUp();
+    compileObjects();
+    prefabs.push_back(std::make_unique<Prefab>(objects));
+    const Prefab* lantern = prefabs.back().get();
+    objects.clear();
+
+    for (int i = 0; i < size; i++) {
+        for (int j = 0; j < size; j++) {
+            glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3((i - size / 2) * 12.0f, -4.0f, -j * 12.0f));
+            transform = glm::rotate(transform, (i * size + j) * 0.3f, glm::vec3(0.0f, 1.0f, 0.0f));
+            transform = glm::translate(transform, glm::vec3(-3.5f, 0.0f, -3.5f));
+            objects.push_back(arena.create<Instance>(lantern, transform));
+        }
+    }
+
+    print("prefab objects:", lantern->getObjects().size(), "instances:", objects.size(),
+          "prefab KB:", lantern->getMemoryUsage() / 1024);
+}
+
+// Spheres orbiting the scene and cubes circling closer in the other direction
+void setUpMovers() {
+    uint16_t red = addMaterial({Color(200, 40, 40), 0.8, 0.2, 10.0f, 0.0f, 0.0f});
+    uint16_t blue = addMaterial({Color(40, 60, 200), 0.6, 0.4, 20.0f, 0.0f, 0.0f});
+
+    AABB bounds;
+    for (const auto& object : objects) {
+        bounds.expand(object->getBounds());
+    }
+    orbitCenter = bounds.centroid();
+    orbitRadius = 0.6f * std::max(bounds.max.x - bounds.min.x, bounds.max.z - bounds.min.z) + 1.0f;
+
+    for (int i = 0; i < 8; i++) {
+        movingSpheres.push_back(arena.create<Sphere>(orbitCenter, 0.7f, red));
+        objects.push_back(movingSpheres.back());
+    }
+    for (int i = 0; i < 4; i++) {
+        movingCubes.push_back(arena.create<Cube>(orbitCenter, orbitCenter + glm::vec3(1.0f), blue));
+        objects.push_back(movingCubes.back());
+    }
+}
+
+void moveObjects(float time) {
+    for (size_t i = 0; i < movingSpheres.size(); i++) {
+        float angle = time + i * 6.2832f / movingSpheres.size();
+        glm::vec3 offset(std::cos(angle) * orbitRadius, std::sin(time * 2.0f + i), std::sin(angle) * orbitRadius);
+        movingSpheres[i]->setCenter(orbitCenter + offset);
+    }
+    for (size_t i = 0; i < movingCubes.size(); i++) {
+        float angle = -time + i * 6.2832f / movingCubes.size();
+        glm::vec3 corner = orbitCenter + glm::vec3(std::cos(angle), 0.0f, std::sin(angle)) * orbitRadius * 0.7f;
+        movingCubes[i]->setCorners(corner, corner + glm::vec3(1.0f));
+    }
+}
+
+// Closest hits of the rays, traced options.packetSize at a time
+void tracePacket(RayPacket& rays) {
+    stats.rays += rays.size;
+    int packetSize = std::min(options.packetSize, RayPacket::MAX_SIZE);
+    if (packetSize <= 1) {
+        for (int i = 0; i < rays.size; i++) {
+            rays.intersects[i] = accelerator->rayIntersect(Ray(rays.origins[i], rays.directions[i]), rays.objects[i]);
+        }
+        return;
+    }
+
+    for (int first = 0; first < rays.size; first += packetSize) {
+        RayPacket packet;
+        for (int i = first; i < std::min(rays.size, first + packetSize); i++) {
+            packet.add(rays.origins[i], rays.directions[i]);
+        }
+        accelerator->rayIntersectPacket(packet);
+        for (int i = 0; i < packet.size; i++) {
+            rays.intersects[first + i] = packet.intersects[i];
+            rays.objects[first + i] = packet.objects[i];
+        }
+    }
+}
+
+// Whether the color of a primary hit can stand in for its pixel in the next
+// frames: the surface is only lit, so its color barely depends on the view
+bool isReusable(const TracedHit& hit) {
+    return hit.intersect.isIntersecting && materials[hit.object->material].shading == SHADE_LIT;
+}
+
+// Shades up to a packet of pixels into `colors`, leaving their primary hits in
+// `primary`. Pixels the reprojection cache stands in for take the color it
+// kept, without tracing or shading anything. For the others the primary rays, unless rasterized,
+// and the reflection rays leaving flat reflective faces are traced as packets.
+// Pixels outside the calling thread's tile (`own` false) do not update the
+// reprojection cache `cache`, whose entries belong to the thread rendering them.
+void shadePixels(const glm::ivec2* pixels, int count, bool rasterized, const Camera& view, ReprojectionCache* cache,
+                 bool own, Color* colors, TracedHit* primary) {
+    int traced[RayPacket::MAX_SIZE];
+    int tracedCount = 0;
+    for (int i = 0; i < count; i++) {
+        if (!cache || !cache->isReused(pixels[i].x, pixels[i].y)) {
+            traced[tracedCount++] = i;
+            continue;
+        }
+        cache->reuse(pixels[i].x, pixels[i].y, primary[i].intersect, primary[i].object, colors[i]);
+        // The visibility buffer was rasterized for these pixels too, see render()
+        if (rasterized && cache->hasMoved()) {
+            const VisibilityBuffer::Sample& sample = visibility.getSample(pixels[i].x, pixels[i].y);
+            if (sample.object != primary[i].object || sample.intersect.owner != primary[i].intersect.owner) {
+                traced[tracedCount++] = i;
+                continue;
+            }
+        }
+        if (own) {
+            cache->renew(pixels[i].x, pixels[i].y);
+        }
+        stats.reprojected++;
+    }
+
+    RayPacket rays;
+    for (int j = 0; j < tracedCount; j++) {
+        const glm::ivec2& pixel = pixels[traced[j]];
+        if (rasterized) {
+            stats.rays++;
+            const VisibilityBuffer::Sample& sample = visibility.getSample(pixel.x, pixel.y);
+            primary[traced[j]] = {sample.intersect, sample.object};
+        } else {
+            rays.add(view.position, visibility.getDirection(pixel.x, pixel.y));
+        }
+    }
+    if (!rasterized) {
+        tracePacket(rays);
+        for (int j = 0; j < tracedCount; j++) {
+            primary[traced[j]] = {rays.intersects[j], rays.objects[j]};
+        }
+    }
+
+    RayPacket reflections;
+    int lanes[RayPacket::MAX_SIZE];
+    for (int j = 0; j < tracedCount; j++) {
+        const TracedHit& hit = primary[traced[j]];
+        lanes[j] = -1;
+        if (!hit.intersect.isIntersecting || options.maxDepth < 2) {
+            continue;
+        }
+        const Material& mat = materials[hit.object->material];
+        if ((mat.shading & SHADE_REFLECT) && mat.reflectivity >= options.minWeight) {
+            glm::vec3 origin, direction;
+            reflectionRay(hit.intersect, origin, direction);
+            lanes[j] = reflections.size;
+            reflections.add(origin, direction);
+        }
+    }
+    tracePacket(reflections);
+
+    for (int j = 0; j < tracedCount; j++) {
+        int i = traced[j];
+        TracedHit reflection;
+        if (lanes[j] >= 0) {
+            reflection = {reflections.intersects[lanes[j]], reflections.objects[lanes[j]]};
+        }
+        glm::vec3 rayDirection = visibility.getDirection(pixels[i].x, pixels[i].y);
+        colors[i] = shade({view.position, rayDirection, 1.0f, 0, &primary[i], lanes[j] >= 0 ? &reflection : nullptr});
+        if (own && cache) {
+            if (isReusable(primary[i])) {
+                cache->store(pixels[i].x, pixels[i].y, primary[i].intersect, primary[i].object, colors[i]);
+            } else {
+                cache->forget(pixels[i].x, pixels[i].y);
+            }
+        }
+    }
+    stats.pixelsRendered += count;
+}
+
+// Pixel i of a block in Z-order, so that packets of 4 and 8 rays cover 2x2 and 4x2 pixels
+glm::ivec2 blockPixel(int blockX, int blockY, int i) {
+    return glm::ivec2(blockX + (i & 1) + ((i >> 1) & 2), blockY + ((i >> 1) & 1) + ((i >> 2) & 2));
+}
+
+// Shades the pixels of one block from `first` on in Z-order, only those of this
+// frame's interleave class; the others keep their history
+void renderBlock(int blockX, int blockY, int first, bool rasterized, const Camera& view, ReprojectionCache* cache,
+                 Framebuffer& target) {
+    const int size = BLOCK_SIZE * BLOCK_SIZE;
+    glm::ivec2 pixels[size];
+    int count = 0;
+    for (int i = first; i < size; i++) {
+        glm::ivec2 pixel = blockPixel(blockX, blockY, i);
+        if (interleave->isRendered(pixel.x, pixel.y)) {
+            pixels[count++] = pixel;
+        }
+    }
+
+    Color colors[size];
+    TracedHit primary[size];
+    shadePixels(pixels, count, rasterized, view, cache, true, colors, primary);
+    for (int i = 0; i < count; i++) {
+        target.at(pixels[i].x, pixels[i].y) = colors[i];
+    }
+}
+
+// A pixel of the coarse lattice of --adaptive, one per block corner
+struct LatticeSample {
+    bool valid = false;     // false past the edge of the screen
+    Color color;
+    const Object* object = nullptr;
+    const Object* owner = nullptr;
+    glm::vec3 normal;
+};
+
+// Whether a block can be interpolated from its corners: they see the same
+// object (or all the sky) on faces turned the same way, and their colors differ
+// by at most `threshold` levels
+bool isSmooth(const LatticeSample* corners[4], float threshold) {
+    int low[3] = {255, 255, 255};
+    int high[3] = {0, 0, 0};
+    for (int i = 0; i < 4; i++) {
+        const LatticeSample& corner = *corners[i];
+        if (!corner.valid || corner.object != corners[0]->object || corner.owner != corners[0]->owner ||
+            (corner.object && glm::dot(corner.normal, corners[0]->normal) < ADAPTIVE_NORMAL_TOLERANCE)) {
+            return false;
+        }
+        int channels[3] = {corner.color.r, corner.color.g, corner.color.b};
+        for (int c = 0; c < 3; c++) {
+            low[c] = std::min(low[c], channels[c]);
+            high[c] = std::max(high[c], channels[c]);
+        }
+    }
+    for (int c = 0; c < 3; c++) {
+        if (high[c] - low[c] > threshold) {
+            return false;
+        }
+    }
+    return true;
+}
 
-            float random_value = static_cast<float>(std::rand())/static_cast<float>(RAND_MAX);
-            if (random_value < 0.0 ) {
+// Renders a tile with --adaptive: first the corners of its blocks, every
+// BLOCK_SIZE pixels, then every pixel of the blocks whose corners differ by
+// more than `threshold`. The other blocks are interpolated from their corners.
+// Corners on the far edges belong to the next tiles and are shaded by both.
+void renderTileAdaptive(int tileX, int tileY, int width, int height, bool rasterized, const Camera& view,
+                        float threshold, ReprojectionCache* cache, Framebuffer& target) {
+    const int side = TILE_SIZE / BLOCK_SIZE + 1;
+    LatticeSample lattice[side * side];
+
+    // Corners in packets, the tile's own apart from those of its neighbours
+    glm::ivec2 pixels[RayPacket::MAX_SIZE];
+    int indices[RayPacket::MAX_SIZE];
+    int count = 0;
+    auto flush = [&](bool own) {
+        Color colors[RayPacket::MAX_SIZE];
+        TracedHit primary[RayPacket::MAX_SIZE];
+        shadePixels(pixels, count, rasterized, view, cache, own, colors, primary);
+        for (int i = 0; i < count; i++) {
+            const Intersect& intersect = primary[i].intersect;
+            lattice[indices[i]] = {true, colors[i], primary[i].object, intersect.owner, intersect.normal};
+            if (own) {
+                target.at(pixels[i].x, pixels[i].y) = colors[i];
+            }
+        }
+        count = 0;
+    };
+    for (bool own : {true, false}) {
+        for (int i = 0; i < side * side; i++) {
+            glm::ivec2 pixel(tileX + i % side * BLOCK_SIZE, tileY + i / side * BLOCK_SIZE);
+            bool inside = pixel.x < tileX + width && pixel.y < tileY + height;
+            if (inside != own || pixel.x >= SCREEN_WIDTH || pixel.y >= SCREEN_HEIGHT) {
                 continue;
             }
+            pixels[count] = pixel;
+            indices[count++] = i;
+            if (count == RayPacket::MAX_SIZE) {
+                flush(own);
+            }
+        }
+        if (count > 0) {
+            flush(own);
+        }
+    }
 
+    for (int y = 0; y < height; y += BLOCK_SIZE) {
+        for (int x = 0; x < width; x += BLOCK_SIZE) {
+            int corner = y / BLOCK_SIZE * side + x / BLOCK_SIZE;
+            const LatticeSample* corners[4] = {&lattice[corner], &lattice[corner + 1],
+                                               &lattice[corner + side], &lattice[corner + side + 1]};
+            if (!isSmooth(corners, threshold)) {
+                renderBlock(tileX + x, tileY + y, 1, rasterized, view, cache, target);
+                continue;
+            }
 
+            // Bilinear between the corners, the first pixel being the corner itself
+            glm::vec3 colors[4];
+            for (int i = 0; i < 4; i++) {
+                colors[i] = glm::vec3(corners[i]->color.r, corners[i]->color.g, corners[i]->color.b);
+            }
+            for (int i = 1; i < BLOCK_SIZE * BLOCK_SIZE; i++) {
+                float u = static_cast<float>(i % BLOCK_SIZE) / BLOCK_SIZE;
+                float v = static_cast<float>(i / BLOCK_SIZE) / BLOCK_SIZE;
+                glm::vec3 color = glm::mix(glm::mix(colors[0], colors[1], u), glm::mix(colors[2], colors[3], u), v);
+                glm::ivec2 pixel(tileX + x + i % BLOCK_SIZE, tileY + y + i / BLOCK_SIZE);
+                target.at(pixel.x, pixel.y) = Color(static_cast<int>(color.r + 0.5f), static_cast<int>(color.g + 0.5f),
+                                                    static_cast<int>(color.b + 0.5f));
+                if (cache) {
+                    cache->forget(pixel.x, pixel.y);
+                }
+            }
+            stats.interpolated += BLOCK_SIZE * BLOCK_SIZE - 1;
+        }
+    }
+}
 
-            float screenX = (2.0f * (x + 0.5f)) / SCREEN_WIDTH - 1.0f;
-            float screenY = -(2.0f * (y + 0.5f)) / SCREEN_HEIGHT + 1.0f;
-            screenX *= ASPECT_RATIO;
-            screenX *= tan(fov/2.0f);
-            screenY *= tan(fov/2.0f);
+// Renders the tile at (tileX, tileY) block by block, or adaptively when
+// `adaptive` is not negative. On interleaved frames the tile starts as a copy
+// of the previous frame, for the pixels not rendered.
+void renderTile(int tileX, int tileY, bool rasterized, const Camera& view, float adaptive, ReprojectionCache* cache,
+                Framebuffer& target, Framebuffer* previous) {
+    int width = std::min(TILE_SIZE, SCREEN_WIDTH - tileX);
+    int height = std::min(TILE_SIZE, SCREEN_HEIGHT - tileY);
+    if (previous && interleave->isPartial()) {
+        for (int y = tileY; y < tileY + height; y++) {
+            std::copy_n(&previous->at(tileX, y), width, &target.at(tileX, y));
+            if (cache) {
+                cache->keep(tileX, y, width);
+            }
+        }
+    }
+    if (adaptive >= 0.0f) {
+        renderTileAdaptive(tileX, tileY, width, height, rasterized, view, adaptive, cache, target);
+        return;
+    }
+    for (int y = 0; y < height; y += BLOCK_SIZE) {
+        for (int x = 0; x < width; x += BLOCK_SIZE) {
+            renderBlock(tileX + x, tileY + y, 0, rasterized, view, cache, target);
+        }
+    }
+}
 
+// Renders a frame from `view` into `target`, adaptively with the threshold
+// `adaptive` unless negative and with the reprojection cache `cache` when given,
+// counting into `totals`
+void render(const Camera& view, Framebuffer& target, Framebuffer* previous, float adaptive, ReprojectionCache* cache,
+            Stats& totals) {
+    // Primary hits come from the visibility buffer, unless --primary trace
+    bool rasterized = options.primary == "raster";
+    visibility.setCamera(view);
+    // Once the camera moves, what hides a reused pixel is found by rasterizing
+    // it anyway, far cheaper than the any-hit ray traced otherwise
+    if (cache) {
+        cache->beginFrame(view, *interleave, rasterized ? nullptr : accelerator, *renderPool, totals);
+    }
+    if (rasterized) {
+        bool skip = cache && !cache->hasMoved();
+        visibility.rasterize(objects, *interleave, skip ? cache->getReused() : nullptr, *renderPool, totals);
+    }
 
-            glm::vec3 cameraDir = glm::normalize(camera.target - camera.position);
+    renderPool->run(TILES_X * TILES_Y, [&](int tile, int) {
+        renderTile(tile % TILES_X * TILE_SIZE, tile / TILES_X * TILE_SIZE, rasterized, view, adaptive, cache, target,
+                   previous);
+    }, totals);
+}
+
+// Renders the --adaptive frame just rendered in `target` again in full, without
+// the reprojection cache, and counts the time of both and the pixels that
+// differ. The full frame counts into its own stats, which are dropped.
+void checkAdaptive(const Camera& view, Framebuffer& target, std::chrono::steady_clock::duration adaptiveTime) {
+    Stats fullStats;
+    auto fullStart = std::chrono::steady_clock::now();
+    render(view, *fullFrame, nullptr, -1.0f, nullptr, fullStats);
+    auto fullTime = std::chrono::steady_clock::now() - fullStart;
+
+    stats.adaptiveChecks++;
+    stats.adaptiveMicros += std::chrono::duration_cast<std::chrono::microseconds>(adaptiveTime).count();
+    stats.fullMicros += std::chrono::duration_cast<std::chrono::microseconds>(fullTime).count();
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        for (int x = 0; x < SCREEN_WIDTH; x++) {
+            const Color& adaptive = target.at(x, y);
+            const Color& full = fullFrame->at(x, y);
+            if (adaptive.r != full.r || adaptive.g != full.g || adaptive.b != full.b) {
+                stats.pixelsDiffering++;
+            }
+        }
+    }
+}
 
-            glm::vec3 cameraX = glm::normalize(glm::cross(cameraDir, camera.up));
-            glm::vec3 cameraY = glm::normalize(glm::cross(cameraX, cameraDir));
-            glm::vec3 rayDirection = glm::normalize(
-                    cameraDir + cameraX * screenX + cameraY * screenY
-            );
+Camera snapshotCamera() {
+    std::lock_guard<std::mutex> lock(cameraMutex);
+    return camera;
+}
 
-            Color pixelColor = castRay(camera.position, rayDirection);
-            /* Color pixelColor = castRay(glm::vec3(0,0,20), glm::normalize(glm::vec3(screenX, screenY, -1.0f))); */
+// Body of the render thread: renders frames one after the other until the
+// pipeline stops, each from the camera and the animation time of the moment it
+// starts. Only this thread touches the scene while the main loop runs.
+void renderLoop() {
+    // The last frame rendered, the history of the pixels an interleaved frame skips.
+    // It is either shown or waiting to be, so the pipeline never hands it out.
+    Framebuffer* previous = nullptr;
+    uint64_t frame = 0;
+    while (Framebuffer* target = pipeline->acquire()) {
+        Camera view = snapshotCamera();
+        if (options.animate) {
+            moveObjects(SDL_GetTicks() / 1000.0f);
+            auto refitStart = std::chrono::steady_clock::now();
+            accelerator->refit(*renderPool);
+            stats.refitMicros += std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - refitStart).count();
+        }
 
-            point(glm::vec2(x, y), pixelColor);
+        auto renderStart = std::chrono::steady_clock::now();
+        render(view, *target, previous, options.adaptive, reprojection, stats);
+        if (fullFrame && frame++ % ADAPTIVE_CHECK_PERIOD == 0) {
+            checkAdaptive(view, *target, std::chrono::steady_clock::now() - renderStart);
         }
+        previous = target;
+        interleave->advance();
+        stats.framesRendered++;
+        pipeline->publish(stats);
     }
 }
 
 int main(int argc, char* argv[]) {
+    options = parseOptions(argc, argv);
+    options.maxDepth = std::clamp(options.maxDepth, 1, MAX_DEPTH);
+    accelerator = createAccelerator(options.accelerator);
+    if (!accelerator) {
+        SDL_Log("Unknown accelerator: %s", options.accelerator.c_str());
+        return 1;
+    }
+    renderPool = new RenderPool(options.threads, options.pin);
+    // Both leave pixels untraced, interleaving over time and --adaptive in space
+    if (options.adaptive >= 0.0f && options.interleave > 1) {
+        print("--adaptive is ignored with --interleave");
+        options.adaptive = -1.0f;
+    }
+    interleave = new Interleave(SCREEN_WIDTH, SCREEN_HEIGHT, std::clamp(options.interleave, 1, 64), options.pattern);
+    // Cached colors would go stale as soon as something moves
+    if (options.reproject && !options.animate) {
+        reprojection = new ReprojectionCache(SCREEN_WIDTH, SCREEN_HEIGHT, FOV);
+    }
+    print("render threads:", renderPool->getThreadCount(), "tiles:", TILES_X * TILES_Y);
+
     // Initialize SDL
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         SDL_Log("Unable to initialize SDL: %s", SDL_GetError());
@@ -426,6 +1024,19 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    pipeline = new FramePipeline(renderer, SCREEN_WIDTH, SCREEN_HEIGHT, std::clamp(options.buffers, 2, 3));
+    if (!pipeline->isValid()) {
+        SDL_Log("Unable to create texture: %s", SDL_GetError());
+        delete pipeline;
+        SDL_DestroyRenderer(renderer);
+        SDL_DestroyWindow(window);
+        SDL_Quit();
+        return 1;
+    }
+
+    if (options.adaptive >= 0.0f && options.checkAdaptive) {
+        fullFrame = new Framebuffer(renderer, SCREEN_WIDTH, SCREEN_HEIGHT);
+    }
 
     bool running = true;
     SDL_Event event;
@@ -434,8 +1045,40 @@ int main(int argc, char* argv[]) {
     Uint32 startTime = SDL_GetTicks();
     Uint32 currentTime = startTime;
 
-    setUp();
+    if (options.scene == "blocks") {
+        setUpBlocks(options.sceneSize);
+        compileObjects();
+    } else if (options.scene == "lanterns") {
+        setUpLanterns(options.sceneSize);
+    } else {
+        setUp();
+        compileObjects();
+    }
+    if (options.animate) {
+        setUpMovers();
+        moveObjects(0.0f);
+    }
+
+    // Prefab parts live in the arena too, so the scene's objects are its records but the dropped ones
+    size_t sceneObjects = arena.getObjectCount() - droppedObjects;
+    print("scene objects:", sceneObjects, "dropped objects:", droppedObjects, "materials:", materials.size(),
+          "arena KB:", arena.getMemoryUsage() / 1024,
+          "bytes/object:", static_cast<float>(arena.getMemoryUsage()) / std::max<size_t>(1, sceneObjects));
+
+    Uint32 buildStart = SDL_GetTicks();
+    accelerator->build(objects);
+    print("accelerator:", accelerator->getName(), "objects:", objects.size(), "build ms:", SDL_GetTicks() - buildStart,
+          "memory KB:", accelerator->getMemoryUsage() / 1024,
+          "bytes/object:", static_cast<float>(accelerator->getMemoryUsage()) / std::max<size_t>(1, objects.size()));
+    // Only the BVHs refit their boxes, the cells of grid and svo hold the objects themselves
+    if (options.animate && (options.accelerator == "grid" || options.accelerator == "svo")) {
+        print("--animate rebuilds", accelerator->getName(), "every frame");
+    }
 
+    print("frame buffers:", pipeline->getBufferCount(), "interleave:", interleave->getCount(), options.pattern,
+          "reprojection:", reprojection ? "on" : "off", "adaptive:", options.adaptive);
+
+    std::thread renderThread(renderLoop);
 
     while (running) {
         while (SDL_PollEvent(&event)) {
@@ -444,6 +1087,7 @@ int main(int argc, char* argv[]) {
             }
 
             if (event.type == SDL_KEYDOWN) {
+                std::lock_guard<std::mutex> lock(cameraMutex);
                 switch(event.key.keysym.sym) {
                     case SDLK_UP:
                         print("up");
@@ -475,27 +1119,62 @@ int main(int argc, char* argv[]) {
 
         }
 
-        // Clear the screen
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-        SDL_RenderClear(renderer);
-
-        render();
-
-        // Present the renderer
-        SDL_RenderPresent(renderer);
-
-        frameCount++;
+        // Present the newest finished frame, if any, without waiting long for
+        // one, so that events are still handled while a slow frame renders. The
+        // frame covers the whole window, nothing to clear.
+        if (Framebuffer* frame = pipeline->takeFrame(std::chrono::milliseconds(PRESENT_WAIT_MS))) {
+            frame->present();
+            SDL_RenderPresent(renderer);
+            frameCount++;
+        }
 
         // Calculate and display FPS
-        if (SDL_GetTicks() - currentTime >= 1000) {
+        Uint32 elapsed = SDL_GetTicks() - currentTime;
+        if (elapsed >= 1000 && frameCount > 0) {
             currentTime = SDL_GetTicks();
             std::string title = "Raytracer - FPS: " + std::to_string(frameCount);
             SDL_SetWindowTitle(window, title.c_str());
+
+            uint64_t totalRays = std::max<uint64_t>(1, stats.rays + stats.shadowRays);
+            uint64_t framesRendered = std::max<uint64_t>(1, stats.framesRendered);
+            print("rays/s:", totalRays * 1000 / elapsed,
+                  "rays/frame:", totalRays / framesRendered,
+                  "frames rendered:", stats.framesRendered,
+                  "dropped:", stats.framesDropped,
+                  "object tests/ray:", static_cast<float>(stats.objectTests) / std::max<uint64_t>(1, stats.rays),
+                  "nodes/ray:", static_cast<float>(stats.nodeVisits) / totalRays,
+                  "shadow rays/s:", stats.shadowNanos > 0 ? stats.shadowRays * 1000000000 / stats.shadowNanos : 0,
+                  "shadow tests/ray:", static_cast<float>(stats.shadowTests) / std::max<uint64_t>(1, stats.shadowRays),
+                  "shadow cache hits:", static_cast<float>(stats.shadowCacheHits) / std::max<uint64_t>(1, stats.shadowRays),
+                  "culled rays:", static_cast<float>(stats.culledRays) / std::max<uint64_t>(1, stats.rays),
+                  "traced pixels:", static_cast<float>(stats.pixelsRendered) /
+                                    std::max<uint64_t>(1, stats.pixelsRendered + stats.interpolated),
+                  "adaptive speedup:", static_cast<float>(stats.fullMicros) / std::max<uint64_t>(1, stats.adaptiveMicros),
+                  "differing pixels/frame:", static_cast<float>(stats.pixelsDiffering) /
+                                             std::max<uint64_t>(1, stats.adaptiveChecks),
+                  "reuse ratio:", static_cast<float>(stats.reprojected) / std::max<uint64_t>(1, stats.pixelsRendered),
+                  "pass-throughs/ray:", static_cast<float>(stats.passThroughs) / std::max<uint64_t>(1, stats.rays),
+                  "packet fallbacks:", static_cast<float>(stats.packetFallbacks) / std::max<uint64_t>(1, stats.packets),
+                  "stolen tiles/frame:", static_cast<float>(stats.tilesStolen) / framesRendered,
+                  "refit ms/frame:", stats.refitMicros / 1000.0f / framesRendered,
+                  "rebuilds:", stats.rebuilds);
+            stats.reset();
             frameCount = 0;
         }
     }
 
     // Cleanup
+    pipeline->stop();
+    renderThread.join();
+    delete renderPool;
+    delete interleave;
+    delete reprojection;
+    delete fullFrame;
+    delete accelerator;
+    objects.clear();
+    arena.clear();
+    prefabs.clear();
+    delete pipeline;
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
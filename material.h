@@ -1,7 +1,20 @@
 #pragma once
 
+#include <cmath>
+#include <cstdint>
+#include <vector>
 #include "color.h"
 
+// Terms of the shading a material needs, combined into Material::shading.
+// Each combination has its own shading kernel, so a matte surface never
+// reaches the reflection or refraction code.
+enum ShadingTerm : uint8_t {
+    SHADE_LIT = 1,      // diffuse or specular light, needs a shadow ray
+    SHADE_REFLECT = 2,
+    SHADE_REFRACT = 4,
+    SHADE_PASS = 8,     // transparent with a refraction index of 1: instead of refracting, the ray goes on
+};
+
 struct Material {
     Color diffuse;
     float albedo;
@@ -10,4 +23,51 @@ struct Material {
     float reflectivity;
     float transparency;
     float refractionIndex;
-};
\ No newline at end of file
+
+    // Set by addMaterial
+    uint8_t shading = 0;        // ShadingTerm bits
+    int specularPower = -1;     // specularCoefficient when it is a small whole number, otherwise -1
+};
+
+inline bool sameMaterial(const Material& a, const Material& b) {
+    return a.diffuse.r == b.diffuse.r && a.diffuse.g == b.diffuse.g && a.diffuse.b == b.diffuse.b &&
+           a.diffuse.a == b.diffuse.a && a.albedo == b.albedo && a.specularAlbedo == b.specularAlbedo &&
+           a.specularCoefficient == b.specularCoefficient && a.reflectivity == b.reflectivity &&
+           a.transparency == b.transparency && a.refractionIndex == b.refractionIndex;
+}
+
+// Materials of the scene; objects keep an index into this table
+inline std::vector<Material> materials;
+
+// Index of the material in the table, added unless an equal one is there
+inline uint16_t addMaterial(const Material& material) {
+    for (size_t i = 0; i < materials.size(); i++) {
+        if (sameMaterial(materials[i], material)) {
+            return static_cast<uint16_t>(i);
+        }
+    }
+    Material classified = material;
+    classified.shading = (material.albedo > 0 || material.specularAlbedo > 0 ? SHADE_LIT : 0) |
+                         (material.reflectivity > 0 ? SHADE_REFLECT : 0) |
+                         (material.transparency > 0 ? (material.refractionIndex == 1.0f ? SHADE_PASS : SHADE_REFRACT) : 0);
+    float power = material.specularCoefficient;
+    classified.specularPower = power >= 0 && power <= 64 && power == std::floor(power) ? static_cast<int>(power) : -1;
+
+    materials.push_back(classified);
+    return static_cast<uint16_t>(materials.size() - 1);
+}
+
+// x raised to the specular coefficient, by squaring when it is a whole number
+inline float specularFalloff(const Material& material, float x) {
+    if (material.specularPower < 0) {
+        return std::pow(x, material.specularCoefficient);
+    }
+    float result = 1.0f;
+    for (int power = material.specularPower; power > 0; power >>= 1) {
+        if (power & 1) {
+            result *= x;
+        }
+        x *= x;
+    }
+    return result;
+}
@@ -1,13 +1,120 @@
 #pragma once
 
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include "glm/glm.hpp"
 #include "material.h"
 #include "intersect.h"
+#include "aabb.h"
+#include "ray.h"
 
+// Every object type registers an ObjectKind (see registerObjectKind) and passes
+// the returned tag to the constructor. The accelerators call the object through
+// that tag; the virtual functions remain for everything outside the hot loops.
 class Object {
 public:
-    Object(const Material& mat) : material(mat) {}
-    virtual Intersect rayIntersect(const glm::vec3& rayOrigin, const glm::vec3& rayDirection) const = 0;
+    Object(uint16_t material, uint8_t kind) : material(material), kind(kind) {}
+    virtual AABB getBounds() const = 0;
 
-    Material material;
-};
\ No newline at end of file
+    // Distance pass: whether and where the ray hits, without the point or normal.
+    // Hits farther than ray.tMax are misses.
+    virtual Hit hit(const Ray& ray) const = 0;
+
+    // Point, normal and uv of a hit returned by hit() for the same ray
+    virtual Intersect finalize(const Ray& ray, const Hit& hit) const = 0;
+
+    Intersect rayIntersect(const Ray& ray) const {
+        return finalize(ray, hit(ray));
+    }
+
+    // Whether the ray hits the object at a distance in (ray.tMin, ray.tMax),
+    // without computing the hit point or normal. Used by shadow rays.
+    virtual bool occluded(const Ray& ray) const = 0;
+
+    // Only called when hasParts is set (see Instance): closest hit in
+    // (ray.tMin, ray.tMax] among the objects this one is made of, skipping
+    // `ignore`. `part` gets the object that was hit, whose material is the one
+    // to shade with.
+    virtual Hit hitParts(const Ray& ray, Object*& part, const Object* ignore) const {
+        part = nullptr;
+        return Hit{};
+    }
+
+    // finalize() for a hit of hitParts on `part`
+    virtual Intersect finalizeParts(const Ray& ray, const Object* part, const Hit& hit) const {
+        return Intersect{};
+    }
+
+    // occluded() for objects with hasParts set, skipping `ignore` among the parts
+    virtual bool occludedParts(const Ray& ray, const Object* ignore) const {
+        return false;
+    }
+
+    uint16_t material;  // index into materials
+    uint8_t kind;
+    bool hasParts = false;
+
+protected:
+    // Objects live in a SceneArena, which drops them without destroying them,
+    // so nothing is ever deleted through an Object*
+    ~Object() = default;
+};
+
+// Functions of one object type, looked up by Object::kind. They call the type's
+// own methods non-virtually, so they can be inlined into the dispatch.
+struct ObjectKind {
+    Hit (*hit)(const Object& object, const Ray& ray);
+    Intersect (*finalize)(const Object& object, const Ray& ray, const Hit& hit);
+    bool (*occluded)(const Object& object, const Ray& ray);
+    Hit (*hitParts)(const Object& object, const Ray& ray, Object*& part, const Object* ignore);
+    Intersect (*finalizeParts)(const Object& object, const Ray& ray, const Object* part, const Hit& hit);
+    bool (*occludedParts)(const Object& object, const Ray& ray, const Object* ignore);
+    AABB (*getBounds)(const Object& object);
+};
+
+// Zero-initialized before any registration runs, whatever the order of the
+// static initializers registering the kinds
+const int MAX_OBJECT_KINDS = 16;
+inline ObjectKind objectKinds[MAX_OBJECT_KINDS];
+inline int objectKindCount = 0;
+
+// Adds T to the dispatch table and returns its tag, e.g.
+// `const uint8_t Cube::KIND = registerObjectKind<Cube>();`
+// Aborts when the table is full: this runs in static initializers, before
+// anything could report the error, and a tag past the end would corrupt memory.
+template <typename T>
+uint8_t registerObjectKind() {
+    if (objectKindCount >= MAX_OBJECT_KINDS) {
+        std::fputs("registerObjectKind: more than MAX_OBJECT_KINDS object types\n", stderr);
+        std::abort();
+    }
+    objectKinds[objectKindCount] = {
+            [](const Object& object, const Ray& ray) {
+                return static_cast<const T&>(object).T::hit(ray);
+            },
+            [](const Object& object, const Ray& ray, const Hit& hit) {
+                return static_cast<const T&>(object).T::finalize(ray, hit);
+            },
+            [](const Object& object, const Ray& ray) {
+                return static_cast<const T&>(object).T::occluded(ray);
+            },
+            [](const Object& object, const Ray& ray, Object*& part, const Object* ignore) {
+                return static_cast<const T&>(object).T::hitParts(ray, part, ignore);
+            },
+            [](const Object& object, const Ray& ray, const Object* part, const Hit& hit) {
+                return static_cast<const T&>(object).T::finalizeParts(ray, part, hit);
+            },
+            [](const Object& object, const Ray& ray, const Object* ignore) {
+                return static_cast<const T&>(object).T::occludedParts(ray, ignore);
+            },
+            [](const Object& object) {
+                return static_cast<const T&>(object).T::getBounds();
+            },
+    };
+    return static_cast<uint8_t>(objectKindCount++);
+}
+
+inline const ObjectKind& objectKind(const Object* object) {
+    return objectKinds[object->kind];
+}
\ No newline at end of file
@@ -0,0 +1,302 @@
+#include "octree.h"
+#include <algorithm>
+#include <bit>
+#include <climits>
+#include <cmath>
+#include "cube.h"
+#include "print.h"
+#include "stats.h"
+
+namespace {
+
+// Unit cubes with ordered corners on integer coordinates
+bool voxelPosition(const Object* object, glm::ivec3& position) {
+    if (object->kind != Cube::KIND) {
+        return false;
+    }
+    auto cube = static_cast<const Cube*>(object);
+    const glm::vec3& minCorner = cube->getMinCorner();
+    if (cube->getMaxCorner() != minCorner + 1.0f || glm::floor(minCorner) != minCorner) {
+        return false;
+    }
+    position = glm::ivec3(minCorner);
+    return true;
+}
+
+// Interleaves 21 bits with two zero bits each, for 63-bit Morton codes
+uint64_t spreadBits(uint32_t v) {
+    uint64_t x = v & 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffffull;
+    x = (x | x << 16) & 0x1f0000ff0000ffull;
+    x = (x | x << 8) & 0x100f00f00f00f00full;
+    x = (x | x << 4) & 0x10c30c30c30c30c3ull;
+    x = (x | x << 2) & 0x1249249249249249ull;
+    return x;
+}
+
+// Octant i of a node has x in bit 0, y in bit 1 and z in bit 2, same as the code
+uint64_t mortonCode(const glm::ivec3& p) {
+    return spreadBits(p.x) | spreadBits(p.y) << 1 | spreadBits(p.z) << 2;
+}
+
+// Entry and exit distances of a box, with the axes the ray enters and leaves through.
+// Axes the ray is parallel to never become the entry or exit axis of the march.
+void boxInterval(const glm::vec3& boxMin, float size, const Ray& ray, float& tNear, float& tFar, int& entryAxis,
+                 int& exitAxis) {
+    tNear = -std::numeric_limits<float>::infinity();
+    tFar = std::numeric_limits<float>::infinity();
+    entryAxis = 0;
+    exitAxis = 0;
+    for (int i = 0; i < 3; i++) {
+        if (ray.direction[i] == 0.0f) {
+            if (ray.origin[i] < boxMin[i] || ray.origin[i] > boxMin[i] + size) {
+                tNear = std::numeric_limits<float>::infinity();
+            }
+            continue;
+        }
+        float nearPlane = ray.dirIsNeg[i] ? boxMin[i] + size : boxMin[i];
+        float farPlane = ray.dirIsNeg[i] ? boxMin[i] : boxMin[i] + size;
+        float t0 = (nearPlane - ray.origin[i]) * ray.invDirection[i];
+        float t1 = (farPlane - ray.origin[i]) * ray.invDirection[i];
+        if (t0 > tNear) {
+            tNear = t0;
+            entryAxis = i;
+        }
+        if (t1 < tFar) {
+            tFar = t1;
+            exitAxis = i;
+        }
+    }
+}
+}
+
+void SparseVoxelOctree::build(const std::vector<Object*>& sceneObjects) {
+    objects = sceneObjects;
+    nodes.clear();
+    voxels.clear();
+    depth = 0;
+
+    struct Voxel {
+        glm::ivec3 position;
+        uint64_t code;
+        uint32_t index;
+    };
+    std::vector<Voxel> found;
+    std::vector<Object*> rest;
+    glm::ivec3 low(INT_MAX);
+    glm::ivec3 high(INT_MIN);
+
+    for (uint32_t i = 0; i < objects.size(); i++) {
+        glm::ivec3 position;
+        if (!voxelPosition(objects[i], position)) {
+            rest.push_back(objects[i]);
+            continue;
+        }
+        found.push_back({position, 0, i});
+        low = glm::min(low, position);
+        high = glm::max(high, position);
+    }
+
+    if (!found.empty()) {
+        int extent = glm::max(glm::max(high.x - low.x, high.y - low.y), high.z - low.z) + 1;
+        depth = 1;
+        while ((1 << depth) < extent) {
+            depth++;
+        }
+        if (depth > MAX_DEPTH) {
+            for (const Voxel& voxel : found) {
+                rest.push_back(objects[voxel.index]);
+            }
+            found.clear();
+            depth = 0;
+        }
+    }
+    others.build(rest);
+    if (found.empty()) {
+        return;
+    }
+
+    origin = low;
+    for (Voxel& voxel : found) {
+        voxel.code = mortonCode(voxel.position - origin);
+    }
+    // Sorted by Morton code every node covers a contiguous range, children in octant order.
+    // Repeated cubes keep the first one in scene order, like the closest-hit tie rule.
+    std::sort(found.begin(), found.end(), [](const Voxel& a, const Voxel& b) {
+        return a.code != b.code ? a.code < b.code : a.index < b.index;
+    });
+    found.erase(std::unique(found.begin(), found.end(), [](const Voxel& a, const Voxel& b) {
+        return a.code == b.code;
+    }), found.end());
+
+    // Breadth-first, so the existing children of a node are stored next to each other
+    struct Range {
+        uint32_t node;
+        size_t begin;
+        size_t end;
+    };
+    std::vector<Range> level = {{0, 0, found.size()}};
+    std::vector<Range> next;
+    nodes.push_back({0, 0});
+
+    for (int l = 0; l < depth; l++) {
+        int shift = 3 * (depth - 1 - l);
+        bool lastLevel = l == depth - 1;
+        next.clear();
+
+        for (const Range& range : level) {
+            nodes[range.node].firstChild = static_cast<uint32_t>(lastLevel ? voxels.size() : nodes.size());
+            size_t i = range.begin;
+            while (i < range.end) {
+                int octant = static_cast<int>((found[i].code >> shift) & 7);
+                size_t j = i;
+                while (j < range.end && static_cast<int>((found[j].code >> shift) & 7) == octant) {
+                    j++;
+                }
+                nodes[range.node].childMask |= static_cast<uint8_t>(1 << octant);
+                if (lastLevel) {
+                    voxels.push_back(found[i].index);
+                } else {
+                    next.push_back({static_cast<uint32_t>(nodes.size()), i, j});
+                    nodes.push_back({0, 0});
+                }
+                i = j;
+            }
+        }
+        std::swap(level, next);
+    }
+
+    print("svo voxels:", voxels.size(), "nodes:", nodes.size(),
+          "bytes/voxel:", static_cast<float>(nodes.size() * sizeof(Node) + voxels.size() * sizeof(uint32_t)) / voxels.size());
+}
+
+size_t SparseVoxelOctree::getMemoryUsage() const {
+    return nodes.size() * sizeof(Node) + voxels.size() * sizeof(uint32_t) + others.getMemoryUsage();
+}
+
+bool SparseVoxelOctree::findVoxel(const Ray& ray, const Object* ignore, float& tHit, int& hitAxis,
+                                  uint32_t& voxel) const {
+    if (nodes.empty()) {
+        return false;
+    }
+
+    const int rootSize = 1 << depth;
+    const glm::vec3& rayOrigin = ray.origin;
+    const glm::vec3& rayDirection = ray.direction;
+
+    float tEnter, tExit;
+    int entryAxis, exitAxis;
+    boxInterval(glm::vec3(origin), static_cast<float>(rootSize), ray, tEnter, tExit, entryAxis, exitAxis);
+    // The march starts at tMin, hits before it are not wanted
+    float tStart = std::max(ray.tMin, 0.0f);
+    if (tEnter > tExit || tExit < tStart) {
+        return false;
+    }
+
+    struct Frame {
+        uint32_t node;
+        glm::ivec3 min;
+        int size;
+    };
+    Frame stack[MAX_DEPTH + 1];
+    int top = 0;
+    stack[0] = {0, origin, rootSize};
+
+    float t = std::max(tEnter, tStart);
+    glm::ivec3 cell = glm::clamp(glm::ivec3(glm::floor(rayOrigin + rayDirection * t)), origin, origin + rootSize - 1);
+    while (t <= ray.tMax) {
+        // Short stack: climb only as far as the deepest node still containing the cell
+        while (top > 0) {
+            glm::ivec3 local = cell - stack[top].min;
+            if (local.x >= 0 && local.y >= 0 && local.z >= 0 &&
+                local.x < stack[top].size && local.y < stack[top].size && local.z < stack[top].size) {
+                break;
+            }
+            top--;
+        }
+
+        glm::ivec3 skipMin;
+        int skipSize;
+        while (true) {
+            const Frame& frame = stack[top];
+            const Node& node = nodes[frame.node];
+            stats.nodeVisits++;
+
+            int half = frame.size / 2;
+            glm::ivec3 local = cell - frame.min;
+            int octant = (local.x >= half) | (local.y >= half) << 1 | (local.z >= half) << 2;
+            glm::ivec3 childMin = frame.min + glm::ivec3(octant & 1, (octant >> 1) & 1, (octant >> 2) & 1) * half;
+
+            if ((node.childMask & (1 << octant)) == 0) {
+                skipMin = childMin;
+                skipSize = half;
+                break;
+            }
+
+            uint32_t child = node.firstChild + std::popcount(static_cast<uint32_t>(node.childMask & ((1 << octant) - 1)));
+            if (half > 1) {
+                stack[++top] = {child, childMin, half};
+                continue;
+            }
+
+            // Occupied voxel: the first one found along the ray is the nearest
+            float tNear, tFar;
+            boxInterval(glm::vec3(childMin), 1.0f, ray, tNear, tFar, entryAxis, exitAxis);
+            if (tNear > ray.tMin && objects[voxels[child]] != ignore) {
+                tHit = tNear;
+                hitAxis = entryAxis;
+                voxel = child;
+                return tNear < ray.tMax;
+            }
+            skipMin = childMin;
+            skipSize = 1;
+            break;
+        }
+
+        // Jump past the empty (or skipped) box into the cell across its exit face
+        float tNear;
+        boxInterval(glm::vec3(skipMin), static_cast<float>(skipSize), ray, tNear, t, entryAxis, exitAxis);
+        cell = glm::clamp(glm::ivec3(glm::floor(rayOrigin + rayDirection * t)), skipMin, skipMin + skipSize - 1);
+        cell[exitAxis] = rayDirection[exitAxis] > 0 ? skipMin[exitAxis] + skipSize : skipMin[exitAxis] - 1;
+        glm::ivec3 rel = cell - origin;
+        if (rel[exitAxis] < 0 || rel[exitAxis] >= rootSize) {
+            break;
+        }
+    }
+
+    return false;
+}
+
+Intersect SparseVoxelOctree::rayIntersect(const Ray& ray, Object*& hitObject, const Object* ignore,
+                                          const Object* ignoreOwner) const {
+    // Objects that are not voxels first: their hit bounds how far the octree is marched
+    ClosestHit closest{ray, ignore, ignoreOwner};
+    others.findClosest(closest);
+
+    float tHit;
+    int axis;
+    uint32_t voxel;
+    if (findVoxel(closest.ray, ignore, tHit, axis, voxel)) {
+        // Voxels are unit cubes at integer coordinates, the uv is the fraction on the face
+        glm::vec3 point = ray.origin + tHit * ray.direction;
+        glm::vec3 normal(0.0f);
+        normal[axis] = ray.dirIsNeg[axis] ? 1.0f : -1.0f;
+        glm::vec2 uv(glm::fract(point[(axis + 1) % 3]), glm::fract(point[(axis + 2) % 3]));
+        hitObject = objects[voxels[voxel]];
+        return Intersect{true, tHit, point, normal, uv};
+    }
+    hitObject = closest.object;
+    return closest.finalize();
+}
+
+bool SparseVoxelOctree::occluded(const Ray& ray, const Object*& occluder, const Object* ignore,
+                                 const Object* ignoreOwner) const {
+    float tHit;
+    int axis;
+    uint32_t voxel;
+    if (findVoxel(ray, ignore, tHit, axis, voxel)) {
+        occluder = objects[voxels[voxel]];
+        return true;
+    }
+    return others.occluded(ray, occluder, ignore, ignoreOwner);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "glm/glm.hpp"
+#include "accelerator.h"
+#include "bvh.h"
+#include "intersect.h"
+#include "object.h"
+
+// Sparse voxel octree for block worlds. Unit cubes on integer coordinates are
+// stored as voxels holding the index of their cube among the scene objects, so
+// hits report the cube itself (and its material) and memory grows with the
+// occupied voxels and not with the size of the world. Rays march
+// through it skipping whole empty octants; the path from the root is kept on a
+// short stack so each step only re-descends from the deepest node that still
+// contains the ray. Any other object goes into a regular BVH next to the octree.
+class SparseVoxelOctree : public Accelerator {
+public:
+    struct Node {
+        uint32_t firstChild;    // first existing child in `nodes`, or in `voxels` on the last level
+        uint8_t childMask;      // bit i set when octant i is occupied
+    };
+
+    void build(const std::vector<Object*>& sceneObjects) override;
+
+    Intersect rayIntersect(const Ray& ray, Object*& hitObject, const Object* ignore = nullptr,
+                           const Object* ignoreOwner = nullptr) const override;
+
+    bool occluded(const Ray& ray, const Object*& occluder, const Object* ignore = nullptr,
+                  const Object* ignoreOwner = nullptr) const override;
+
+    size_t getMemoryUsage() const override;
+
+    std::string getName() const override {
+        return "svo";
+    }
+
+private:
+    static const int MAX_DEPTH = 21;
+
+    // Marches to the first voxel entered after ray.tMin, skipping the voxel of
+    // the ignored cube, and reports it only if it is entered before ray.tMax
+    bool findVoxel(const Ray& ray, const Object* ignore, float& tHit, int& hitAxis, uint32_t& voxel) const;
+
+    glm::ivec3 origin = glm::ivec3(0);
+    int depth = 0;
+    std::vector<Node> nodes;
+    std::vector<uint32_t> voxels;           // index in `objects` of the cube filling each occupied voxel
+    BVH others;                             // objects that are not voxels
+};
@@ -0,0 +1,55 @@
+#include "options.h"
+#include "print.h"
+
+Options parseOptions(int argc, char* argv[]) {
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--accel" && hasValue) {
+            options.accelerator = argv[++i];
+        } else if (arg == "--scene" && hasValue) {
+            options.scene = argv[++i];
+        } else if (arg == "--size" && hasValue) {
+            options.sceneSize = std::stoi(argv[++i]);
+        } else if (arg == "--compile" && hasValue) {
+            options.compile = argv[++i];
+        } else if (arg == "--primary" && hasValue) {
+            options.primary = argv[++i];
+        } else if (arg == "--packet" && hasValue) {
+            options.packetSize = std::stoi(argv[++i]);
+        } else if (arg == "--depth" && hasValue) {
+            options.maxDepth = std::stoi(argv[++i]);
+        } else if (arg == "--min-weight" && hasValue) {
+            options.minWeight = std::stof(argv[++i]);
+        } else if (arg == "--roulette" && hasValue) {
+            options.roulette = std::stof(argv[++i]);
+        } else if (arg == "--threads" && hasValue) {
+            options.threads = std::stoi(argv[++i]);
+        } else if (arg == "--buffers" && hasValue) {
+            options.buffers = std::stoi(argv[++i]);
+        } else if (arg == "--interleave" && hasValue) {
+            options.interleave = std::stoi(argv[++i]);
+        } else if (arg == "--pattern" && hasValue) {
+            options.pattern = argv[++i];
+        } else if (arg == "--adaptive" && hasValue) {
+            options.adaptive = std::stof(argv[++i]);
+        } else if (arg == "--check-adaptive") {
+            options.checkAdaptive = true;
+        } else if (arg == "--reproject") {
+            options.reproject = true;
+        } else if (arg == "--pin") {
+            options.pin = true;
+        } else if (arg == "--animate") {
+            options.animate = true;
+        } else if (arg == "--time-shadows") {
+            options.timeShadows = true;
+        } else {
+            print("Unknown option:", arg);
+        }
+    }
+
+    return options;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+
+// Startup options, e.g. `Proyecto3 --accel bvh8 --scene blocks --size 128 --animate`
+struct Options {
+    std::string accelerator = "bvh";    // bvh, bvh4, bvh8, grid, svo
+    std::string scene = "lantern";      // lantern, blocks, lanterns
+    std::string compile = "merge";      // off, merge (bigger boxes) or faces (quads without hidden faces)
+    std::string primary = "raster";     // raster (visibility buffer) or trace
+    int maxDepth = 3;                   // levels of the ray tree, 1 shades only what the camera sees
+    float minWeight = 1.0f / 255;       // reflection and refraction rays weighing less in the pixel are not traced
+    float roulette = 0.0f;              // lighter rays survive at random (Russian roulette), 0 disables it
+    int packetSize = 16;                // rays traced together, 1 traces them one at a time
+    int threads = 0;                    // render threads, 0 for one per hardware thread
+    bool pin = false;                   // keep each render thread on its own core
+    int buffers = 2;                    // frame buffers, 2 (double buffering) or 3 (triple buffering)
+    int interleave = 1;                 // frames over which every pixel is rendered once, the others keep their history
+    std::string pattern = "bayer";      // pixels of each interleaved frame: bayer (regular) or noise (blue-noise-like)
+    float adaptive = -1.0f;             // blocks whose corners differ by at most this many levels are interpolated, negative disables it
+    bool checkAdaptive = false;         // with adaptive, render one frame in 16 in full too, to report the speedup and the differing pixels
+    bool reproject = false;             // reuse the last frame's colors on surfaces still in view, ignored with animate
+    bool animate = false;               // moving spheres and cubes, refitting the accelerator every frame
+    bool timeShadows = false;           // time every shadow ray to report shadow rays/s, at two clock reads per ray
+    int sceneSize = 64;                 // side of the blocks scene in cubes, or of the lanterns scene in lanterns
+};
+
+Options parseOptions(int argc, char* argv[]);
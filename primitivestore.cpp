@@ -0,0 +1,196 @@
+#include "primitivestore.h"
+#include <algorithm>
+#include <bit>
+#include <limits>
+#include "cube.h"
+#include "quad.h"
+#include "sphere.h"
+#include "stats.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// The few vector operations the kernels need, LANES wide. Operands of min and
+// max are swapped to match glm::min and glm::max when a lane holds NaN.
+#if defined(__AVX__)
+typedef __m256 Vec;
+Vec load(const float* p) { return _mm256_loadu_ps(p); }
+Vec set1(float v) { return _mm256_set1_ps(v); }
+Vec add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+Vec sub(Vec a, Vec b) { return _mm256_sub_ps(a, b); }
+Vec mul(Vec a, Vec b) { return _mm256_mul_ps(a, b); }
+Vec min(Vec x, Vec y) { return _mm256_min_ps(y, x); }
+Vec max(Vec x, Vec y) { return _mm256_max_ps(y, x); }
+int lessThan(Vec a, Vec b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ)); }
+void store(float* p, Vec v) { _mm256_storeu_ps(p, v); }
+#elif defined(__SSE2__) || defined(_M_X64)
+typedef __m128 Vec;
+Vec load(const float* p) { return _mm_loadu_ps(p); }
+Vec set1(float v) { return _mm_set1_ps(v); }
+Vec add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+Vec sub(Vec a, Vec b) { return _mm_sub_ps(a, b); }
+Vec mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+Vec min(Vec x, Vec y) { return _mm_min_ps(y, x); }
+Vec max(Vec x, Vec y) { return _mm_max_ps(y, x); }
+int lessThan(Vec a, Vec b) { return _mm_movemask_ps(_mm_cmplt_ps(a, b)); }
+void store(float* p, Vec v) { _mm_storeu_ps(p, v); }
+#else
+typedef float Vec;
+Vec load(const float* p) { return *p; }
+Vec set1(float v) { return v; }
+Vec add(Vec a, Vec b) { return a + b; }
+Vec sub(Vec a, Vec b) { return a - b; }
+Vec mul(Vec a, Vec b) { return a * b; }
+Vec min(Vec x, Vec y) { return glm::min(x, y); }
+Vec max(Vec x, Vec y) { return glm::max(x, y); }
+int lessThan(Vec a, Vec b) { return a < b ? 1 : 0; }
+void store(float* p, Vec v) { *p = v; }
+#endif
+
+const int ALL_LANES = (1 << PrimitiveStore::LANES) - 1;
+
+}
+
+void PrimitiveStore::build(const std::vector<Object*>& objects, const std::vector<uint32_t>& order) {
+    size_t size = order.size() + LANES;
+    for (auto* array : {&minX, &minY, &minZ, &maxX, &maxY, &maxZ}) {
+        array->assign(size, 0.0f);
+    }
+    kinds.assign(size, OTHER);
+    objectIndex = order;
+
+    for (uint32_t slot = 0; slot < order.size(); slot++) {
+        const Object* object = objects[order[slot]];
+        if (object->kind == Cube::KIND || object->kind == Quad::KIND) {
+            kinds[slot] = BOX;
+        } else if (object->kind == Sphere::KIND) {
+            kinds[slot] = SPHERE;
+        }
+        read(slot, object);
+    }
+}
+
+void PrimitiveStore::update(const std::vector<Object*>& objects) {
+    for (uint32_t slot = 0; slot < objectIndex.size(); slot++) {
+        read(slot, objects[objectIndex[slot]]);
+    }
+}
+
+void PrimitiveStore::read(uint32_t slot, const Object* object) {
+    if (kinds[slot] == BOX) {
+        glm::vec3 minCorner, maxCorner;
+        if (object->kind == Quad::KIND) {
+            minCorner = static_cast<const Quad*>(object)->getMinCorner();
+            maxCorner = static_cast<const Quad*>(object)->getMaxCorner();
+        } else {
+            minCorner = static_cast<const Cube*>(object)->getMinCorner();
+            maxCorner = static_cast<const Cube*>(object)->getMaxCorner();
+        }
+        minX[slot] = minCorner.x;
+        minY[slot] = minCorner.y;
+        minZ[slot] = minCorner.z;
+        maxX[slot] = maxCorner.x;
+        maxY[slot] = maxCorner.y;
+        maxZ[slot] = maxCorner.z;
+    } else if (kinds[slot] == SPHERE) {
+        auto sphere = static_cast<const Sphere*>(object);
+        minX[slot] = sphere->getCenter().x;
+        minY[slot] = sphere->getCenter().y;
+        minZ[slot] = sphere->getCenter().z;
+        maxX[slot] = sphere->getRadius();
+    }
+}
+
+void PrimitiveStore::intersect(uint32_t first, uint32_t count, const std::vector<Object*>& objects,
+                               ClosestHit& closest) const {
+    const Ray& ray = closest.ray;
+    const Vec ox = set1(ray.origin.x), oy = set1(ray.origin.y), oz = set1(ray.origin.z);
+    const Vec dx = set1(ray.direction.x), dy = set1(ray.direction.y), dz = set1(ray.direction.z);
+    const Vec ix = set1(ray.invDirection.x), iy = set1(ray.invDirection.y), iz = set1(ray.invDirection.z);
+    const Vec zero = set1(0.0f);
+    const float a = glm::dot(ray.direction, ray.direction);
+
+    uint32_t end = first + count;
+    for (uint32_t slot = first; slot < end; slot += LANES) {
+        int valid = end - slot >= LANES ? ALL_LANES : (1 << (end - slot)) - 1;
+        int boxes = 0, spheres = 0;
+        for (int lane = 0; lane < LANES; lane++) {
+            boxes |= (kinds[slot + lane] == BOX) << lane;
+            spheres |= (kinds[slot + lane] == SPHERE) << lane;
+        }
+        boxes &= valid;
+        spheres &= valid;
+        int tested = boxes | spheres;
+
+        // Same operations as Cube::hit and Quad::hit, so the
+        // distances are bit-identical
+        float tNear[LANES];
+        int boxHits = 0;
+        if (boxes) {
+            Vec t0x = mul(sub(load(&minX[slot]), ox), ix);
+            Vec t0y = mul(sub(load(&minY[slot]), oy), iy);
+            Vec t0z = mul(sub(load(&minZ[slot]), oz), iz);
+            Vec t1x = mul(sub(load(&maxX[slot]), ox), ix);
+            Vec t1y = mul(sub(load(&maxY[slot]), oy), iy);
+            Vec t1z = mul(sub(load(&maxZ[slot]), oz), iz);
+            Vec nearT = max(max(min(t0x, t1x), min(t0y, t1y)), min(t0z, t1z));
+            Vec farT = min(min(max(t0x, t1x), max(t0y, t1y)), max(t0z, t1z));
+            store(tNear, nearT);
+            boxHits = boxes & ~(lessThan(farT, nearT) | lessThan(farT, zero) | lessThan(set1(ray.tMax), nearT));
+        }
+
+        // Same discriminant as Sphere::hit; the lanes it does not reject
+        // are rare enough to be tested exactly
+        if (spheres) {
+            Vec ocx = sub(ox, load(&minX[slot]));
+            Vec ocy = sub(oy, load(&minY[slot]));
+            Vec ocz = sub(oz, load(&minZ[slot]));
+            Vec radius = load(&maxX[slot]);
+            Vec b = mul(set1(2.0f), add(add(mul(ocx, dx), mul(ocy, dy)), mul(ocz, dz)));
+            Vec c = sub(add(add(mul(ocx, ocx), mul(ocy, ocy)), mul(ocz, ocz)), mul(radius, radius));
+            Vec discriminant = sub(mul(b, b), mul(set1(4 * a), c));
+            int candidates = spheres & ~lessThan(discriminant, zero);
+            tested &= ~candidates;
+            for (int lane = 0; candidates; lane++, candidates >>= 1) {
+                if (candidates & 1) {
+                    uint32_t index = objectIndex[slot + lane];
+                    closest.test(objects[index], index);
+                }
+            }
+        }
+
+        stats.objectTests += std::popcount(static_cast<unsigned>(tested));
+
+        int others = valid & ~(boxes | spheres);
+        for (int lane = 0; others; lane++, others >>= 1) {
+            if (others & 1) {
+                closest.test(objects[objectIndex[slot + lane]], objectIndex[slot + lane]);
+            }
+        }
+
+        // Only the nearest box can be recorded, ties going to the lower scene index
+        int best = -1;
+        for (int lane = 0; boxHits; lane++, boxHits >>= 1) {
+            uint32_t index = objectIndex[slot + lane];
+            if (!(boxHits & 1) || tNear[lane] <= ray.tMin || objects[index] == closest.ignore) {
+                continue;
+            }
+            if (best < 0 || tNear[lane] < tNear[best] ||
+                (tNear[lane] == tNear[best] && index < objectIndex[slot + best])) {
+                best = lane;
+            }
+        }
+        if (best >= 0) {
+            uint32_t index = objectIndex[slot + best];
+            const Object* object = objects[index];
+            closest.record(objects[index], index, objectKind(object).hit(*object, ray));
+        }
+    }
+}
+
+size_t PrimitiveStore::getMemoryUsage() const {
+    return (minX.size() * 6) * sizeof(float) + kinds.size() * sizeof(uint8_t) + objectIndex.size() * sizeof(uint32_t);
+}
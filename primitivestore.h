@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "glm/glm.hpp"
+#include "accelerator.h"
+#include "object.h"
+
+// Cubes, quads and spheres copied out of their objects into structure-of-arrays
+// slots, so that one ray is tested against LANES of them at once (8 with AVX, 4
+// with SSE). Slots follow the order given at build, which for the BVHs is their leaf
+// order, so the primitives of a leaf are contiguous. Other objects (instances)
+// keep their slot but are tested through Object::hit.
+class PrimitiveStore {
+public:
+#if defined(__AVX__)
+    static const int LANES = 8;
+#elif defined(__SSE2__) || defined(_M_X64)
+    static const int LANES = 4;
+#else
+    static const int LANES = 1;
+#endif
+
+    // Slot i holds objects[order[i]]
+    void build(const std::vector<Object*>& objects, const std::vector<uint32_t>& order);
+
+    // Reads the corners and centers again after the objects moved
+    void update(const std::vector<Object*>& objects);
+
+    // Offers the hits on slots [first, first + count) to `closest`, within the
+    // interval of its ray. Box hits (cubes and quads) are found with the SIMD
+    // kernel and only the nearest one is tested again for its face; spheres the
+    // kernel cannot reject are tested exactly.
+    void intersect(uint32_t first, uint32_t count, const std::vector<Object*>& objects, ClosestHit& closest) const;
+
+    size_t getMemoryUsage() const;
+
+private:
+    enum Kind : uint8_t {
+        BOX,
+        SPHERE,
+        OTHER,
+    };
+
+    void read(uint32_t slot, const Object* object);
+
+    // Cubes and quads: min and max corners. Spheres: center in min, radius in maxX.
+    // Padded with LANES unused slots so that full vectors can always be loaded.
+    std::vector<float> minX, minY, minZ;
+    std::vector<float> maxX, maxY, maxZ;
+    std::vector<uint8_t> kinds;
+    std::vector<uint32_t> objectIndex;
+};
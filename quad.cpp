@@ -0,0 +1,54 @@
+#include "quad.h"
+
+const uint8_t Quad::KIND = registerObjectKind<Quad>();
+
+Quad::Quad(const glm::vec3& minCorner, const glm::vec3& maxCorner, const glm::vec3& normal, uint16_t material)
+        : Object(material, KIND), minCorner(minCorner), maxCorner(maxCorner), normal(normal) {}
+
+Hit Quad::hit(const Ray& ray) const {
+    glm::vec3 tMin = (minCorner - ray.origin) * ray.invDirection;
+    glm::vec3 tMax = (maxCorner - ray.origin) * ray.invDirection;
+
+    glm::vec3 t1 = glm::min(tMin, tMax);
+    glm::vec3 t2 = glm::max(tMin, tMax);
+
+    float tNear = glm::max(glm::max(t1.x, t1.y), t1.z);
+    float tFar = glm::min(glm::min(t2.x, t2.y), t2.z);
+
+    if (tNear > tFar || tFar < 0 || tNear > ray.tMax) {
+        return Hit{false};
+    }
+    return Hit{true, tNear};
+}
+
+Intersect Quad::finalize(const Ray& ray, const Hit& hit) const {
+    if (!hit.isIntersecting) {
+        return Intersect{false};
+    }
+
+    glm::vec3 point = ray.origin + hit.dist * ray.direction;
+    int axis = normal.x != 0 ? 0 : (normal.y != 0 ? 1 : 2);
+    int u = (axis + 1) % 3;
+    int v = (axis + 2) % 3;
+    glm::vec2 uv((point[u] - minCorner[u]) / (maxCorner[u] - minCorner[u]),
+                 (point[v] - minCorner[v]) / (maxCorner[v] - minCorner[v]));
+
+    return Intersect{true, hit.dist, point, normal, uv};
+}
+
+bool Quad::occluded(const Ray& ray) const {
+    glm::vec3 tLow = (minCorner - ray.origin) * ray.invDirection;
+    glm::vec3 tHigh = (maxCorner - ray.origin) * ray.invDirection;
+
+    glm::vec3 t1 = glm::min(tLow, tHigh);
+    glm::vec3 t2 = glm::max(tLow, tHigh);
+
+    float tNear = glm::max(glm::max(t1.x, t1.y), t1.z);
+    float tFar = glm::min(glm::min(t2.x, t2.y), t2.z);
+
+    return tNear <= tFar && tFar >= 0 && tNear > ray.tMin && tNear < ray.tMax;
+}
+
+AABB Quad::getBounds() const {
+    return AABB(minCorner, maxCorner);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "glm/glm.hpp"
+#include "object.h"
+#include "material.h"
+#include "intersect.h"
+
+// Axis-aligned rectangle, a face left by compileScene after removing the hidden
+// ones. It is tested like a flat Cube, so the primitive store runs it through
+// the box kernel, but always reports the normal of the face it came from.
+class Quad : public Object {
+public:
+    static const uint8_t KIND;
+
+    Quad(const glm::vec3& minCorner, const glm::vec3& maxCorner, const glm::vec3& normal, uint16_t material);
+
+    Hit hit(const Ray& ray) const override;
+    Intersect finalize(const Ray& ray, const Hit& hit) const override;
+    bool occluded(const Ray& ray) const override;
+    AABB getBounds() const override;
+
+    const glm::vec3& getMinCorner() const {
+        return minCorner;
+    }
+
+    const glm::vec3& getMaxCorner() const {
+        return maxCorner;
+    }
+
+private:
+    glm::vec3 minCorner;
+    glm::vec3 maxCorner;    // equal to minCorner along the normal
+    glm::vec3 normal;
+};
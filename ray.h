@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include "glm/glm.hpp"
+
+// A ray with what the slab tests need computed once: the reciprocal of the
+// direction and its sign on each axis. Only hits in (tMin, tMax] are wanted, and
+// tracing shrinks tMax to the closest hit so far, so boxes and primitives
+// farther away are rejected before any more work is done on them.
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction;
+    glm::vec3 invDirection;
+    bool dirIsNeg[3];
+    float tMin;
+    float tMax;
+
+    // Left uninitialized, for arrays of rays filled afterwards
+    Ray() = default;
+
+    // A zero component gets the largest finite reciprocal with the sign of the
+    // zero instead of infinity, so (plane - origin) * invDirection is never
+    // 0 * inf = NaN, even for an origin lying on the plane
+    Ray(const glm::vec3& origin, const glm::vec3& direction, float tMin = -std::numeric_limits<float>::max(),
+        float tMax = std::numeric_limits<float>::max())
+            : origin(origin), direction(direction),
+              invDirection(glm::clamp(1.0f / direction, -std::numeric_limits<float>::max(),
+                                      std::numeric_limits<float>::max())),
+              dirIsNeg{std::signbit(invDirection.x), std::signbit(invDirection.y), std::signbit(invDirection.z)},
+              tMin(tMin), tMax(tMax) {}
+};
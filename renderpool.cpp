@@ -0,0 +1,129 @@
+#include "renderpool.h"
+#include <algorithm>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+void pinToCore(int core) {
+#if defined(_WIN32)
+    SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << (core % (8 * sizeof(DWORD_PTR))));
+#elif defined(__linux__)
+    cpu_set_t cores;
+    CPU_ZERO(&cores);
+    CPU_SET(core % CPU_SETSIZE, &cores);
+    pthread_setaffinity_np(pthread_self(), sizeof(cores), &cores);
+#endif
+}
+
+}
+
+RenderPool::RenderPool(int threadCount, bool pin) {
+    if (threadCount <= 0) {
+        threadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    workers.reset(new Worker[threadCount]);
+    for (int i = 0; i < threadCount; i++) {
+        threads.emplace_back(&RenderPool::work, this, i, pin);
+    }
+}
+
+RenderPool::~RenderPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    started.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void RenderPool::run(int tileCount, const std::function<void(int tile, int worker)>& renderTile, Stats& totals) {
+    int count = getThreadCount();
+    for (int i = 0; i < count; i++) {
+        std::lock_guard<std::mutex> lock(workers[i].mutex);
+        workers[i].tiles.clear();
+        for (int tile = tileCount * i / count; tile < tileCount * (i + 1) / count; tile++) {
+            workers[i].tiles.push_back(tile);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &renderTile;
+        running = count;
+        frame++;
+    }
+    started.notify_all();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&] { return running == 0; });
+    for (int i = 0; i < count; i++) {
+        totals.add(workers[i].stats);
+    }
+}
+
+void RenderPool::work(int index, bool pin) {
+    if (pin) {
+        pinToCore(index);
+    }
+
+    uint64_t done = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            started.wait(lock, [&] { return stopping || frame != done; });
+            if (stopping) {
+                return;
+            }
+            done = frame;
+        }
+
+        int tile;
+        while (nextTile(index, tile)) {
+            (*job)(tile, index);
+        }
+
+        // Counted on this thread's own Stats (see stats.h), handed over with the frame
+        workers[index].stats = stats;
+        stats.reset();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--running == 0) {
+            finished.notify_one();
+        }
+    }
+}
+
+bool RenderPool::nextTile(int index, int& tile) {
+    {
+        Worker& own = workers[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tiles.empty()) {
+            tile = own.tiles.front();
+            own.tiles.pop_front();
+            return true;
+        }
+    }
+
+    // Steal from the end of the others' runs, farthest from where they are working
+    int count = getThreadCount();
+    for (int i = 1; i < count; i++) {
+        Worker& victim = workers[(index + i) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tiles.empty()) {
+            tile = victim.tiles.back();
+            victim.tiles.pop_back();
+            stats.tilesStolen++;
+            return true;
+        }
+    }
+    return false;
+}
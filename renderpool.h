@@ -0,0 +1,53 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "stats.h"
+
+// Threads kept alive for the whole run that render the tiles of each frame.
+// Every frame the tiles are dealt out in contiguous runs, one per worker; a
+// worker that empties its queue takes tiles from the back of another's, so the
+// sky and the reflective lantern even out whatever the split.
+class RenderPool {
+public:
+    // threads == 0 starts one worker per hardware thread. With pin, worker i
+    // stays on core i.
+    RenderPool(int threads, bool pin);
+    ~RenderPool();
+
+    int getThreadCount() const {
+        return static_cast<int>(threads.size());
+    }
+
+    // Calls renderTile(tile, worker) once for every tile in [0, tileCount) and
+    // returns when all are done. The workers' counters are added to `totals`,
+    // by default the stats of the calling thread.
+    void run(int tileCount, const std::function<void(int tile, int worker)>& renderTile, Stats& totals = stats);
+
+private:
+    // One per worker, on its own cache lines so that queues do not share them
+    struct alignas(64) Worker {
+        std::mutex mutex;
+        std::deque<int> tiles;
+        Stats stats;    // the worker's counters for the last frame
+    };
+
+    void work(int index, bool pin);
+    bool nextTile(int index, int& tile);
+
+    std::vector<std::thread> threads;
+    std::unique_ptr<Worker[]> workers;
+
+    std::mutex mutex;
+    std::condition_variable started;
+    std::condition_variable finished;
+    const std::function<void(int, int)>* job = nullptr;
+    uint64_t frame = 0;
+    int running = 0;
+    bool stopping = false;
+};
@@ -0,0 +1,191 @@
+#include "reprojection.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+namespace {
+
+// Nothing of the last frame landed on the pixel
+const uint64_t EMPTY = UINT64_MAX;
+
+// An entry is rejected when a surface closer by this fraction of its distance
+// lands next to it: the pixel is at an edge that may have uncovered something
+const float DEPTH_TOLERANCE = 0.1f;
+
+// Cosine of the largest angle between the normals of the same face
+const float NORMAL_TOLERANCE = 0.99f;
+
+// Largest difference of a channel between the colors of neighbouring entries:
+// beyond it the pixel may be on a shadow's edge, which it would move
+const int COLOR_TOLERANCE = 4;
+
+// Cosine of the largest angle between the direction an entry was shaded from
+// and the one it is seen from now: beyond it the highlight has moved too much
+const float VIEW_TOLERANCE = 0.999f;
+
+// Fraction of an entry's distance left out of the ray looking for something in
+// front of it, so that the faces next to its own do not count
+const float OCCLUSION_MARGIN = 0.001f;
+
+// Rows moved or resolved by one job of the render pool
+const int BAND_ROWS = 16;
+
+// Distances are positive, so their bits sort like the floats themselves
+uint64_t landingKey(float distance, uint32_t source) {
+    uint32_t bits;
+    std::memcpy(&bits, &distance, sizeof(bits));
+    return static_cast<uint64_t>(bits) << 32 | source;
+}
+
+float landingDistance(uint64_t key) {
+    uint32_t bits = static_cast<uint32_t>(key >> 32);
+    float distance;
+    std::memcpy(&distance, &bits, sizeof(distance));
+    return distance;
+}
+
+}
+
+ReprojectionCache::ReprojectionCache(int width, int height, float fov)
+        : width(width), height(height), origin(0.0f), previous(width * height), current(width * height), landed(width * height),
+          reused(width * height) {
+    scaleY = std::tan(fov / 2.0f);
+    scaleX = scaleY * static_cast<float>(width) / static_cast<float>(height);
+}
+
+void ReprojectionCache::beginFrame(const Camera& camera, const Interleave& pixels, const Accelerator* accelerator,
+                                   RenderPool& pool, Stats& totals) {
+    std::swap(previous, current);
+
+    // Same basis as VisibilityBuffer::setCamera
+    moved = camera.position != origin;
+    origin = camera.position;
+    forward = glm::normalize(camera.target - camera.position);
+    right = glm::normalize(glm::cross(forward, camera.up));
+    up = glm::normalize(glm::cross(right, forward));
+
+    int bands = (height + BAND_ROWS - 1) / BAND_ROWS;
+    pool.run(bands, [&](int band, int) {
+        int end = std::min(height, (band + 1) * BAND_ROWS) * width;
+        for (int i = band * BAND_ROWS * width; i < end; i++) {
+            landed[i].store(EMPTY, std::memory_order_relaxed);
+        }
+    }, totals);
+
+    // Every entry goes to the pixel of the new view its point is seen through,
+    // keeping the nearest of those landing on the same pixel
+    pool.run(bands, [&](int band, int) {
+        int end = std::min(height, (band + 1) * BAND_ROWS) * width;
+        for (int i = band * BAND_ROWS * width; i < end; i++) {
+            const Entry& entry = previous[i];
+            if (!entry.object || entry.age >= MAX_AGE) {
+                continue;
+            }
+            glm::vec3 relative = entry.point - origin;
+            float depth = glm::dot(relative, forward);
+            if (depth <= 0.0f) {
+                continue;
+            }
+            float screenX = glm::dot(relative, right) / (depth * scaleX);
+            float screenY = glm::dot(relative, up) / (depth * scaleY);
+            int x = static_cast<int>(std::floor((screenX + 1.0f) * width / 2.0f));
+            int y = static_cast<int>(std::floor((1.0f - screenY) * height / 2.0f));
+            if (x < 0 || y < 0 || x >= width || y >= height) {
+                continue;
+            }
+
+            uint64_t key = landingKey(glm::length(relative), static_cast<uint32_t>(i));
+            std::atomic<uint64_t>& slot = landed[y * width + x];
+            uint64_t nearest = slot.load(std::memory_order_relaxed);
+            while (key < nearest && !slot.compare_exchange_weak(nearest, key, std::memory_order_relaxed)) {
+            }
+        }
+    }, totals);
+
+    pool.run(bands, [&](int band, int) {
+        int yEnd = std::min(height, (band + 1) * BAND_ROWS);
+        for (int y = band * BAND_ROWS; y < yEnd; y++) {
+            for (int x = 0; x < width; x++) {
+                reused[y * width + x] = pixels.isRendered(x, y) && accept(x, y, accelerator);
+            }
+        }
+    }, totals);
+}
+
+bool ReprojectionCache::accept(int x, int y, const Accelerator* accelerator) const {
+    uint64_t key = landed[y * width + x].load(std::memory_order_relaxed);
+    if (key == EMPTY) {
+        return false;
+    }
+    const Entry& entry = previous[static_cast<uint32_t>(key)];
+    glm::vec3 view = glm::normalize(origin - entry.point);
+    if (glm::dot(entry.normal, view) <= 0.0f || glm::dot(entry.view, view) < VIEW_TOLERANCE) {
+        return false;
+    }
+
+    // Its neighbours must have landed on the same face at about the same
+    // distance, with about the same color. Otherwise the pixel is at an edge,
+    // where the entry may be a point of the next face, show through a gap of a
+    // nearer surface, belong to what that surface hides now or be on the other
+    // side of a shadow's edge.
+    float distance = landingDistance(key);
+    float nearest = distance * (1.0f - DEPTH_TOLERANCE);
+    for (int ny = std::max(0, y - 1); ny <= std::min(height - 1, y + 1); ny++) {
+        for (int nx = std::max(0, x - 1); nx <= std::min(width - 1, x + 1); nx++) {
+            uint64_t neighbourKey = landed[ny * width + nx].load(std::memory_order_relaxed);
+            if (neighbourKey == EMPTY) {
+                return false;
+            }
+            const Entry& neighbour = previous[static_cast<uint32_t>(neighbourKey)];
+            if (neighbour.object != entry.object || neighbour.owner != entry.owner ||
+                glm::dot(neighbour.normal, entry.normal) < NORMAL_TOLERANCE || landingDistance(neighbourKey) < nearest ||
+                std::abs(neighbour.color.r - entry.color.r) > COLOR_TOLERANCE ||
+                std::abs(neighbour.color.g - entry.color.g) > COLOR_TOLERANCE ||
+                std::abs(neighbour.color.b - entry.color.b) > COLOR_TOLERANCE) {
+                return false;
+            }
+        }
+    }
+
+    // A face the last frame saw edge-on or from behind may stand in front of
+    // the entry now, with none of its points in the history to land here. The
+    // default tMin of primary rays counts a cube the camera moved into. From
+    // the same place in a still scene, what was hidden still is.
+    if (!moved || !accelerator) {
+        return true;
+    }
+    Ray ray(origin, (entry.point - origin) / distance, -std::numeric_limits<float>::max(),
+            distance * (1.0f - OCCLUSION_MARGIN));
+    const Object* occluder = nullptr;
+    return !accelerator->occluded(ray, occluder, entry.object, entry.owner);
+}
+
+void ReprojectionCache::reuse(int x, int y, Intersect& hit, Object*& object, Color& color) const {
+    uint64_t key = landed[y * width + x].load(std::memory_order_relaxed);
+    const Entry& entry = previous[static_cast<uint32_t>(key)];
+    hit = Intersect{true, landingDistance(key), entry.point, entry.normal};
+    hit.owner = entry.owner;
+    object = entry.object;
+    color = entry.color;
+}
+
+void ReprojectionCache::renew(int x, int y) {
+    uint64_t key = landed[y * width + x].load(std::memory_order_relaxed);
+    current[y * width + x] = previous[static_cast<uint32_t>(key)];
+    current[y * width + x].age++;
+}
+
+void ReprojectionCache::store(int x, int y, const Intersect& hit, Object* object, Color color) {
+    current[y * width + x] = {hit.point, hit.normal, glm::normalize(origin - hit.point), color, 0, object, hit.owner};
+}
+
+void ReprojectionCache::forget(int x, int y) {
+    current[y * width + x].object = nullptr;
+}
+
+void ReprojectionCache::keep(int x, int y, int count) {
+    std::copy_n(&previous[y * width + x], count, &current[y * width + x]);
+}
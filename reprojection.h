@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "glm/glm.hpp"
+#include "accelerator.h"
+#include "camera.h"
+#include "color.h"
+#include "interleave.h"
+#include "intersect.h"
+#include "object.h"
+#include "renderpool.h"
+#include "stats.h"
+
+// The surfaces the last frame saw, kept per pixel: the world-space hit point,
+// normal and object, with the color it was shaded. As the camera orbits or
+// dollies, most pixels of the new frame see a surface the last one saw too.
+// Each entry is moved to the pixel it lands on in the new view, the nearest one
+// winning, and is accepted there when its neighbours landed on the same face at
+// about the same distance, as at edges the pixel may have been disoccluded or
+// see another face by now. Once the camera has moved, something the last frame
+// did not see may hide the entry too: an any-hit ray looks for it, or the
+// caller compares the entry with the visibility buffer. Accepted pixels take
+// the entry's color as it is: no closest hit, shadow ray nor shading.
+// Only surfaces that are only lit are kept, whose color depends on the view
+// through the highlight alone, and only while they are seen from about the
+// direction they were shaded from. Reflective and transparent surfaces, the
+// sky and pixels nothing lands on are traced again.
+class ReprojectionCache {
+public:
+    // An entry is reused at most this many frames in a row before it is traced again
+    static const uint8_t MAX_AGE = 16;
+
+    ReprojectionCache(int width, int height, float fov);
+
+    // Starts a frame seen from `camera`: the entries of the last frame become the
+    // history and are moved into the new view on the threads of `pool`, deciding
+    // which of the frame's `pixels` reuse one, counting into `totals`. Entries
+    // are checked against the scene in `accelerator`, unless null because the
+    // caller checks them.
+    void beginFrame(const Camera& camera, const Interleave& pixels, const Accelerator* accelerator, RenderPool& pool,
+                    Stats& totals = stats);
+
+    // Whether the camera is elsewhere than in the last frame, so that the
+    // pixels reusing an entry must be checked for what may hide it
+    bool hasMoved() const {
+        return moved;
+    }
+
+    // Nonzero for the pixels that reuse an entry, one byte per pixel in rows
+    const uint8_t* getReused() const {
+        return reused.data();
+    }
+
+    bool isReused(int x, int y) const {
+        return reused[y * width + x] != 0;
+    }
+
+    // The entry pixel (x, y) reuses: its hit as seen from the new camera, its object and its color
+    void reuse(int x, int y, Intersect& hit, Object*& object, Color& color) const;
+
+    // Pixel (x, y) reused its entry and keeps it for the next frame, one frame older
+    void renew(int x, int y);
+
+    // The entry of pixel (x, y) for the next frame, just shaded from this frame's camera
+    void store(int x, int y, const Intersect& hit, Object* object, Color color);
+
+    // Pixel (x, y) has nothing to reuse, e.g. it sees the sky or a mirror
+    void forget(int x, int y);
+
+    // Carries `count` entries from (x, y) on over from the last frame, for pixels the frame does not render
+    void keep(int x, int y, int count);
+
+private:
+    struct Entry {
+        glm::vec3 point;
+        glm::vec3 normal;
+        glm::vec3 view;     // towards the camera it was shaded from
+        Color color;
+        uint8_t age;
+        Object* object = nullptr;
+        const Object* owner = nullptr;
+    };
+
+    // Whether the entry landing on pixel (x, y) can stand in for it
+    bool accept(int x, int y, const Accelerator* accelerator) const;
+
+    int width;
+    int height;
+    float scaleX;
+    float scaleY;
+    glm::vec3 origin;
+    glm::vec3 forward;
+    glm::vec3 right;
+    glm::vec3 up;
+    bool moved = true;
+    std::vector<Entry> previous;
+    std::vector<Entry> current;
+
+    // Per pixel, the nearest entry of the last frame landing on it: the distance
+    // to the camera in the high 32 bits and the entry's pixel in the low ones
+    std::vector<std::atomic<uint64_t>> landed;
+    std::vector<uint8_t> reused;
+};
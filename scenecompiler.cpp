@@ -0,0 +1,152 @@
+#include "scenecompiler.h"
+#include <algorithm>
+#include <array>
+#include <map>
+#include <set>
+#include <tuple>
+#include "cube.h"
+#include "quad.h"
+#include "sphere.h"
+
+namespace {
+
+// A cube or a face being compiled; faces are flat along their axis
+struct Box {
+    glm::vec3 min;
+    glm::vec3 max;
+    uint16_t material;
+    int face;       // 0 for cubes, 1 + 2 * axis + (1 when the normal points to +axis) for faces
+};
+
+// Merges boxes sharing a whole face, one axis after the other: rows along x,
+// then rows of equal rows along y, then along z
+void mergeBoxes(std::vector<Box>& boxes) {
+    for (int axis = 0; axis < 3; axis++) {
+        int u = (axis + 1) % 3;
+        int v = (axis + 2) % 3;
+        auto key = [&](const Box& box) {
+            return std::make_tuple(box.material, box.face, box.min[u], box.max[u], box.min[v], box.max[v],
+                                   box.min[axis]);
+        };
+        std::sort(boxes.begin(), boxes.end(), [&](const Box& a, const Box& b) {
+            return key(a) < key(b);
+        });
+
+        std::vector<Box> merged;
+        for (const Box& box : boxes) {
+            if (!merged.empty()) {
+                Box& last = merged.back();
+                bool sameRow = std::make_tuple(last.material, last.face, last.min[u], last.max[u], last.min[v], last.max[v]) ==
+                               std::make_tuple(box.material, box.face, box.min[u], box.max[u], box.min[v], box.max[v]);
+                if (sameRow && box.min[axis] < box.max[axis] && last.max[axis] == box.min[axis]) {
+                    last.max[axis] = box.max[axis];
+                    continue;
+                }
+            }
+            merged.push_back(box);
+        }
+        boxes = std::move(merged);
+    }
+}
+
+// The six faces of every box, without the ones pressed against another box
+std::vector<Box> exposedFaces(const std::vector<Box>& boxes) {
+    std::vector<Box> faces;
+    std::map<std::array<float, 6>, std::vector<size_t>> facesByRect[2];
+    for (const Box& box : boxes) {
+        for (int axis = 0; axis < 3; axis++) {
+            for (int side = 0; side < 2; side++) {
+                Box face = box;
+                if (side == 1) {
+                    face.min[axis] = box.max[axis];
+                } else {
+                    face.max[axis] = box.min[axis];
+                }
+                face.face = 1 + 2 * axis + side;
+
+                int u = (axis + 1) % 3;
+                int v = (axis + 2) % 3;
+                std::array<float, 6> rect = {static_cast<float>(axis), face.min[axis], face.min[u], face.max[u],
+                                             face.min[v], face.max[v]};
+                facesByRect[side][rect].push_back(faces.size());
+                faces.push_back(face);
+            }
+        }
+    }
+
+    // A face looking at +axis and one looking at -axis on the same rectangle hide each other
+    std::vector<bool> hidden(faces.size(), false);
+    for (const auto& [rect, positive] : facesByRect[1]) {
+        auto negative = facesByRect[0].find(rect);
+        if (negative == facesByRect[0].end()) {
+            continue;
+        }
+        size_t pairs = std::min(positive.size(), negative->second.size());
+        for (size_t i = 0; i < pairs; i++) {
+            hidden[positive[i]] = true;
+            hidden[negative->second[i]] = true;
+        }
+    }
+
+    std::vector<Box> exposed;
+    for (size_t i = 0; i < faces.size(); i++) {
+        if (!hidden[i]) {
+            exposed.push_back(faces[i]);
+        }
+    }
+    return exposed;
+}
+
+}
+
+std::vector<Object*> compileScene(const std::vector<Object*>& objects, bool faces, SceneArena& arena) {
+    std::set<std::array<float, 8>> seen;
+    std::vector<Object*> compiled;
+    std::vector<Box> boxes;
+
+    for (Object* object : objects) {
+        // Same kind, geometry as given and material: only the first copy can be hit
+        std::array<float, 8> key = {static_cast<float>(object->kind), 0, 0, 0, 0, 0, 0, static_cast<float>(object->material)};
+        bool comparable = true;
+        if (object->kind == Cube::KIND) {
+            auto cube = static_cast<const Cube*>(object);
+            glm::vec3 a = cube->getMinCorner(), b = cube->getMaxCorner();
+            key = {key[0], a.x, a.y, a.z, b.x, b.y, b.z, key[7]};
+        } else if (object->kind == Sphere::KIND) {
+            auto sphere = static_cast<const Sphere*>(object);
+            glm::vec3 c = sphere->getCenter();
+            key = {key[0], c.x, c.y, c.z, sphere->getRadius(), 0, 0, key[7]};
+        } else {
+            comparable = false;
+        }
+        if (comparable && !seen.insert(key).second) {
+            continue;
+        }
+
+        if (object->kind == Cube::KIND && materials[object->material].transparency == 0) {
+            auto cube = static_cast<const Cube*>(object);
+            if (glm::all(glm::lessThan(cube->getMinCorner(), cube->getMaxCorner()))) {
+                boxes.push_back({cube->getMinCorner(), cube->getMaxCorner(), object->material, 0});
+                continue;
+            }
+        }
+        compiled.push_back(object);
+    }
+
+    if (faces) {
+        boxes = exposedFaces(boxes);
+    }
+    mergeBoxes(boxes);
+
+    for (const Box& box : boxes) {
+        if (box.face == 0) {
+            compiled.push_back(arena.create<Cube>(box.min, box.max, box.material));
+        } else {
+            int axis = (box.face - 1) / 2;
+            glm::vec3 normal(0.0f);
+            normal[axis] = (box.face - 1) % 2 == 1 ? 1.0f : -1.0f;
+            compiled.push_back(arena.create<Quad>(box.min, box.max, normal, box.material));
+        }
+    }
+    return compiled;
+}
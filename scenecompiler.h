@@ -0,0 +1,18 @@
+#pragma once
+
+#include <vector>
+#include "arena.h"
+#include "object.h"
+
+// Rewrites the scene into fewer primitives that render the same, run once after
+// loading. Exact duplicates are dropped, then opaque cubes with ordered corners
+// (min < max on every axis) are merged greedily with their same-material
+// neighbours into bigger boxes. With `faces`, those cubes are instead split into
+// Quads, faces touching another opaque cube are removed and the remaining
+// coplanar faces are merged the same way. Cubes with swapped corners, which take
+// their normals from the corner order, and transparent cubes, whose refracted
+// rays depend on the box they start in, are kept as they are.
+//
+// New objects are created in `arena`. Objects that are dropped or replaced stay
+// in theirs until it is cleared.
+std::vector<Object*> compileScene(const std::vector<Object*>& objects, bool faces, SceneArena& arena);
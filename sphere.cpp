@@ -1,28 +1,61 @@
 #include "sphere.h"
+#include <cmath>
+#include "glm/gtc/constants.hpp"
 
-Sphere::Sphere(const glm::vec3& center, float radius, const Material& mat)
-        : center(center), radius(radius), Object(mat) {}
+const uint8_t Sphere::KIND = registerObjectKind<Sphere>();
 
-Intersect Sphere::rayIntersect(const glm::vec3& rayOrigin, const glm::vec3& rayDirection) const {
-    glm::vec3 oc = rayOrigin - center;
+Sphere::Sphere(const glm::vec3& center, float radius, uint16_t material)
+        : center(center), radius(radius), Object(material, KIND) {}
 
-    float a = glm::dot(rayDirection, rayDirection);
-    float b = 2.0f * glm::dot(oc, rayDirection);
+Hit Sphere::hit(const Ray& ray) const {
+    glm::vec3 oc = ray.origin - center;
+
+    float a = glm::dot(ray.direction, ray.direction);
+    float b = 2.0f * glm::dot(oc, ray.direction);
     float c = glm::dot(oc, oc) - radius * radius;
 
     float discriminant = b * b - 4 * a * c;
 
     if (discriminant < 0) {
-        return Intersect{false};
+        return Hit{false};
     }
 
     float dist = (-b - sqrt(discriminant)) / (2.0f * a);
 
-    if (dist < 0) {
+    if (dist < 0 || dist > ray.tMax) {
+        return Hit{false};
+    }
+    return Hit{true, dist};
+}
+
+Intersect Sphere::finalize(const Ray& ray, const Hit& hit) const {
+    if (!hit.isIntersecting) {
         return Intersect{false};
     }
 
-    glm::vec3 point = rayOrigin + dist * rayDirection;
+    glm::vec3 point = ray.origin + hit.dist * ray.direction;
     glm::vec3 normal = glm::normalize(point - center);
-    return Intersect{true, dist, point, normal};
+    glm::vec2 uv(0.5f + std::atan2(normal.z, normal.x) / (2.0f * glm::pi<float>()),
+                 0.5f - std::asin(glm::clamp(normal.y, -1.0f, 1.0f)) / glm::pi<float>());
+    return Intersect{true, hit.dist, point, normal, uv};
+}
+
+bool Sphere::occluded(const Ray& ray) const {
+    glm::vec3 oc = ray.origin - center;
+
+    float a = glm::dot(ray.direction, ray.direction);
+    float b = 2.0f * glm::dot(oc, ray.direction);
+    float c = glm::dot(oc, oc) - radius * radius;
+
+    float discriminant = b * b - 4 * a * c;
+    if (discriminant < 0) {
+        return false;
+    }
+
+    float dist = (-b - sqrt(discriminant)) / (2.0f * a);
+    return dist > ray.tMin && dist > 0 && dist < ray.tMax;
+}
+
+AABB Sphere::getBounds() const {
+    return AABB(center - glm::vec3(radius), center + glm::vec3(radius));
 }
\ No newline at end of file
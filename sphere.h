@@ -7,9 +7,27 @@
 
 class Sphere : public Object {
 public:
-    Sphere(const glm::vec3& center, float radius, const Material& mat);
+    static const uint8_t KIND;
 
-    Intersect rayIntersect(const glm::vec3& rayOrigin, const glm::vec3& rayDirection) const override;
+    Sphere(const glm::vec3& center, float radius, uint16_t material);
+
+    Hit hit(const Ray& ray) const override;
+    Intersect finalize(const Ray& ray, const Hit& hit) const override;
+    bool occluded(const Ray& ray) const override;
+    AABB getBounds() const override;
+
+    const glm::vec3& getCenter() const {
+        return center;
+    }
+
+    float getRadius() const {
+        return radius;
+    }
+
+    // Moves the sphere; call Accelerator::refit before tracing again
+    void setCenter(const glm::vec3& newCenter) {
+        center = newCenter;
+    }
 
 private:
     glm::vec3 center;
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+
+// Counters collected while rendering, reported once per second next to the FPS.
+// Every thread counts into its own copy; the render pool adds the workers'
+// copies to the render thread's after each frame, and the frame pipeline hands
+// those to the main thread with the frame.
+struct Stats {
+    uint64_t rays = 0;
+    uint64_t shadowRays = 0;
+    uint64_t objectTests = 0;
+    uint64_t nodeVisits = 0;
+    uint64_t shadowTests = 0;       // object tests made by occlusion queries, not in objectTests
+    uint64_t shadowNanos = 0;       // time spent in shadow rays, only with --time-shadows
+    uint64_t shadowCacheHits = 0;   // shadow rays answered by the last occluder, without traversal
+    uint64_t culledRays = 0;        // reflection and refraction rays not traced because of their weight
+    uint64_t passThroughs = 0;      // transparent surfaces crossed without a new ray
+    uint64_t packets = 0;
+    uint64_t packetFallbacks = 0;   // packets traced one ray at a time because their directions diverge
+    uint64_t refits = 0;
+    uint64_t rebuilds = 0;
+    uint64_t refitMicros = 0;
+    uint64_t tilesStolen = 0;       // tiles a render thread took from another one's queue
+    uint64_t pixelsRendered = 0;    // shaded, corners shared by two tiles of --adaptive count twice
+    uint64_t interpolated = 0;      // pixels filled from the corners of their block by --adaptive
+    uint64_t adaptiveChecks = 0;    // --adaptive frames also rendered in full to compare against
+    uint64_t adaptiveMicros = 0;    // render time of those frames
+    uint64_t fullMicros = 0;        // render time of their full versions
+    uint64_t pixelsDiffering = 0;   // pixels where those frames differ from their full versions
+    uint64_t reprojected = 0;       // pixels colored from the reprojection cache, without shading
+    uint64_t framesRendered = 0;
+    uint64_t framesDropped = 0;     // finished frames replaced by a newer one before they were shown
+
+    void reset() {
+        *this = Stats();
+    }
+
+    void add(const Stats& other) {
+        rays += other.rays;
+        shadowRays += other.shadowRays;
+        objectTests += other.objectTests;
+        nodeVisits += other.nodeVisits;
+        shadowTests += other.shadowTests;
+        shadowNanos += other.shadowNanos;
+        shadowCacheHits += other.shadowCacheHits;
+        culledRays += other.culledRays;
+        passThroughs += other.passThroughs;
+        packets += other.packets;
+        packetFallbacks += other.packetFallbacks;
+        refits += other.refits;
+        rebuilds += other.rebuilds;
+        refitMicros += other.refitMicros;
+        tilesStolen += other.tilesStolen;
+        pixelsRendered += other.pixelsRendered;
+        interpolated += other.interpolated;
+        adaptiveChecks += other.adaptiveChecks;
+        adaptiveMicros += other.adaptiveMicros;
+        fullMicros += other.fullMicros;
+        pixelsDiffering += other.pixelsDiffering;
+        reprojected += other.reprojected;
+        framesRendered += other.framesRendered;
+        framesDropped += other.framesDropped;
+    }
+};
+
+inline thread_local Stats stats;
@@ -0,0 +1,265 @@
+#include "visibility.h"
+#include <algorithm>
+#include <cmath>
+#include "accelerator.h"
+
+namespace {
+
+// Box corners closer to the camera plane than this are clipped away
+const float NEAR_PLANE = 1e-4f;
+
+// Side of the screen tiles that keep the farthest depth of their pixels
+const int TILE_SIZE = 8;
+
+// Side of the bins rasterized in parallel, a multiple of TILE_SIZE
+const int BIN_SIZE = 32;
+
+// Objects are projected in chunks of this many, at most MAX_CHUNKS of them
+const size_t OBJECTS_PER_CHUNK = 1024;
+const int MAX_CHUNKS = 64;
+
+// Lower bound of the distance along any ray from `point` to the box, or -max
+// when the point is inside, where Cube reports hits at negative distances
+float nearestDistance(const AABB& bounds, const glm::vec3& point) {
+    glm::vec3 closest = glm::clamp(point, bounds.min, bounds.max);
+    if (closest == point) {
+        return -std::numeric_limits<float>::max();
+    }
+    return glm::length(closest - point);
+}
+
+}
+
+VisibilityBuffer::VisibilityBuffer(int width, int height, float fov)
+        : width(width), height(height), rays(width * height), samples(width * height) {
+    tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    tileDepths.resize(tilesX * ((height + TILE_SIZE - 1) / TILE_SIZE));
+    binsX = (width + BIN_SIZE - 1) / BIN_SIZE;
+    binsY = (height + BIN_SIZE - 1) / BIN_SIZE;
+    scaleY = std::tan(fov / 2.0f);
+    scaleX = scaleY * static_cast<float>(width) / static_cast<float>(height);
+}
+
+void VisibilityBuffer::setCamera(const Camera& camera) {
+    origin = camera.position;
+    forward = glm::normalize(camera.target - camera.position);
+    right = glm::normalize(glm::cross(forward, camera.up));
+    up = glm::normalize(glm::cross(right, forward));
+}
+
+glm::vec3 VisibilityBuffer::getDirection(int x, int y) const {
+    float screenX = ((2.0f * (x + 0.5f)) / width - 1.0f) * scaleX;
+    float screenY = (-(2.0f * (y + 0.5f)) / height + 1.0f) * scaleY;
+    return glm::normalize(forward + right * screenX + up * screenY);
+}
+
+bool VisibilityBuffer::projectBounds(const AABB& bounds, glm::ivec2& low, glm::ivec2& high) const {
+    glm::vec3 corners[8];
+    float depths[8];
+    for (int i = 0; i < 8; i++) {
+        corners[i] = glm::vec3((i & 1) ? bounds.max.x : bounds.min.x,
+                               (i & 2) ? bounds.max.y : bounds.min.y,
+                               (i & 4) ? bounds.max.z : bounds.min.z);
+        depths[i] = glm::dot(corners[i] - origin, forward);
+    }
+
+    glm::vec2 screenMin(std::numeric_limits<float>::max());
+    glm::vec2 screenMax(-std::numeric_limits<float>::max());
+    auto addPoint = [&](const glm::vec3& point, float depth) {
+        glm::vec3 relative = point - origin;
+        glm::vec2 screen(glm::dot(relative, right) / (depth * scaleX), glm::dot(relative, up) / (depth * scaleY));
+        screenMin = glm::min(screenMin, screen);
+        screenMax = glm::max(screenMax, screen);
+    };
+
+    // The part of the box in front of the camera spans its corners there plus
+    // the points where its edges cross the near plane
+    bool visible = false;
+    for (int i = 0; i < 8; i++) {
+        if (depths[i] >= NEAR_PLANE) {
+            addPoint(corners[i], depths[i]);
+            visible = true;
+        }
+        for (int axis = 0; axis < 3; axis++) {
+            int j = i | (1 << axis);
+            if (j == i || (depths[i] >= NEAR_PLANE) == (depths[j] >= NEAR_PLANE)) {
+                continue;
+            }
+            float s = (NEAR_PLANE - depths[i]) / (depths[j] - depths[i]);
+            addPoint(corners[i] + (corners[j] - corners[i]) * s, NEAR_PLANE);
+        }
+    }
+    if (!visible) {
+        return false;
+    }
+
+    // Screen coordinates to pixel centers, widened by a pixel against rounding
+    float x0 = (screenMin.x + 1.0f) * width / 2.0f - 0.5f;
+    float x1 = (screenMax.x + 1.0f) * width / 2.0f - 0.5f;
+    float y0 = (1.0f - screenMax.y) * height / 2.0f - 0.5f;
+    float y1 = (1.0f - screenMin.y) * height / 2.0f - 0.5f;
+    if (x1 < -1.0f || y1 < -1.0f || x0 > width || y0 > height) {
+        return false;
+    }
+    low = glm::ivec2(std::max(0.0f, std::floor(x0) - 1.0f), std::max(0.0f, std::floor(y0) - 1.0f));
+    high = glm::ivec2(std::min(width - 1.0f, std::ceil(x1) + 1.0f), std::min(height - 1.0f, std::ceil(y1) + 1.0f));
+    return low.x <= high.x && low.y <= high.y;
+}
+
+void VisibilityBuffer::rasterize(const std::vector<Object*>& objects, const Interleave& pixels, const uint8_t* skip,
+                                 RenderPool& pool, Stats& totals) {
+    skipped = skip;
+
+    // Each chunk of objects is projected and sorted into the bins it reaches...
+    int binCount = binsX * binsY;
+    chunkCount = std::clamp(static_cast<int>((objects.size() + OBJECTS_PER_CHUNK - 1) / OBJECTS_PER_CHUNK), 1,
+                            MAX_CHUNKS);
+    bins.resize(static_cast<size_t>(chunkCount) * binCount);
+    pool.run(chunkCount, [&](int chunk, int) {
+        std::vector<Candidate>* chunkBins = &bins[static_cast<size_t>(chunk) * binCount];
+        for (int bin = 0; bin < binCount; bin++) {
+            chunkBins[bin].clear();
+        }
+        size_t end = objects.size() * (chunk + 1) / chunkCount;
+        for (size_t i = objects.size() * chunk / chunkCount; i < end; i++) {
+            AABB bounds = objects[i]->getBounds();
+            Candidate candidate{nearestDistance(bounds, origin), static_cast<uint32_t>(i), bounds};
+            if (!projectBounds(bounds, candidate.low, candidate.high)) {
+                continue;
+            }
+            for (int binY = candidate.low.y / BIN_SIZE; binY <= candidate.high.y / BIN_SIZE; binY++) {
+                for (int binX = candidate.low.x / BIN_SIZE; binX <= candidate.high.x / BIN_SIZE; binX++) {
+                    chunkBins[binY * binsX + binX].push_back(candidate);
+                }
+            }
+        }
+    }, totals);
+
+    // ...then every bin is rasterized on its own, with the pixels it covers
+    pool.run(binCount, [&](int bin, int) {
+        rasterizeBin(bin % binsX, bin / binsX, objects, pixels);
+    }, totals);
+}
+
+void VisibilityBuffer::rasterizeBin(int binX, int binY, const std::vector<Object*>& objects,
+                                   const Interleave& pixels) {
+    glm::ivec2 binLow(binX * BIN_SIZE, binY * BIN_SIZE);
+    glm::ivec2 binHigh = glm::min(binLow + BIN_SIZE, glm::ivec2(width, height)) - 1;
+    for (int y = binLow.y; y <= binHigh.y; y++) {
+        for (int x = binLow.x; x <= binHigh.x; x++) {
+            if (isRasterized(pixels, x, y)) {
+                rays[y * width + x] = Ray(origin, getDirection(x, y));
+                samples[y * width + x] = Sample();
+            }
+        }
+    }
+    for (int tileY = binLow.y / TILE_SIZE; tileY <= binHigh.y / TILE_SIZE; tileY++) {
+        for (int tileX = binLow.x / TILE_SIZE; tileX <= binHigh.x / TILE_SIZE; tileX++) {
+            tileDepths[tileY * tilesX + tileX] = std::numeric_limits<float>::max();
+        }
+    }
+
+    // Nearest first, so farther objects are mostly rejected by depth
+    thread_local std::vector<Candidate> candidates;
+    candidates.clear();
+    for (int chunk = 0; chunk < chunkCount; chunk++) {
+        const std::vector<Candidate>& bin = bins[static_cast<size_t>(chunk) * binsX * binsY + binY * binsX + binX];
+        candidates.insert(candidates.end(), bin.begin(), bin.end());
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        return a.nearest < b.nearest;
+    });
+
+    for (const Candidate& candidate : candidates) {
+        Object* object = objects[candidate.index];
+        glm::ivec2 candidateLow = glm::max(candidate.low, binLow);
+        glm::ivec2 candidateHigh = glm::min(candidate.high, binHigh);
+        for (int tileY = candidateLow.y / TILE_SIZE; tileY <= candidateHigh.y / TILE_SIZE; tileY++) {
+            for (int tileX = candidateLow.x / TILE_SIZE; tileX <= candidateHigh.x / TILE_SIZE; tileX++) {
+                // Every pixel of the tile already has a hit nearer than the object
+                float& tileDepth = tileDepths[tileY * tilesX + tileX];
+                if (tileDepth < candidate.nearest) {
+                    continue;
+                }
+
+                glm::ivec2 low = glm::max(candidateLow, glm::ivec2(tileX, tileY) * TILE_SIZE);
+                glm::ivec2 high = glm::min(candidateHigh, glm::ivec2(tileX, tileY) * TILE_SIZE + TILE_SIZE - 1);
+                bool changed = false;
+                for (int y = low.y; y <= high.y; y++) {
+                    for (int x = low.x; x <= high.x; x++) {
+                        if (!isRasterized(pixels, x, y)) {
+                            continue;
+                        }
+                        changed |= testPixel(x, y, object, candidate.index, candidate.bounds, candidate.nearest);
+                    }
+                }
+                if (changed) {
+                    tileDepth = getTileDepth(tileX, tileY, pixels);
+                }
+            }
+        }
+    }
+
+    // Only the hit left in each pixel gets its point and normal
+    for (int y = binLow.y; y <= binHigh.y; y++) {
+        for (int x = binLow.x; x <= binHigh.x; x++) {
+            if (!isRasterized(pixels, x, y)) {
+                continue;
+            }
+            int i = y * width + x;
+            Sample& sample = samples[i];
+            ClosestHit closest{rays[i], nullptr};
+            closest.hit = sample.hit;
+            closest.object = sample.object;
+            closest.owner = sample.owner;
+            sample.intersect = closest.finalize();
+        }
+    }
+}
+
+bool VisibilityBuffer::testPixel(int x, int y, Object* object, uint32_t index, const AABB& bounds, float nearest) {
+    Sample& sample = samples[y * width + x];
+    if (sample.object && sample.hit.dist < nearest) {
+        return false;
+    }
+
+    // The box test is inlined and skips the normal, most pixels of the rectangle miss
+    ClosestHit closest{rays[y * width + x], nullptr};
+    if (sample.object) {
+        closest.ray.tMax = sample.hit.dist;
+    }
+    if (!bounds.rayIntersect(closest.ray)) {
+        return false;
+    }
+
+    // Same acceptance and tie rule as the accelerators
+    closest.index = sample.index;
+    closest.test(object, index);
+    if (!closest.object) {
+        return false;
+    }
+    sample.hit = closest.hit;
+    sample.object = closest.object;
+    sample.owner = closest.owner;
+    sample.index = closest.index;
+    return true;
+}
+
+float VisibilityBuffer::getTileDepth(int tileX, int tileY, const Interleave& pixels) const {
+    float depth = -std::numeric_limits<float>::max();
+    int yEnd = std::min(height, (tileY + 1) * TILE_SIZE);
+    int xEnd = std::min(width, (tileX + 1) * TILE_SIZE);
+    for (int y = tileY * TILE_SIZE; y < yEnd; y++) {
+        for (int x = tileX * TILE_SIZE; x < xEnd; x++) {
+            if (!isRasterized(pixels, x, y)) {
+                continue;
+            }
+            const Sample& sample = samples[y * width + x];
+            if (!sample.object) {
+                return std::numeric_limits<float>::max();
+            }
+            depth = std::max(depth, sample.hit.dist);
+        }
+    }
+    return depth;
+}
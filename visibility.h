@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "glm/glm.hpp"
+#include "aabb.h"
+#include "camera.h"
+#include "interleave.h"
+#include "intersect.h"
+#include "object.h"
+#include "ray.h"
+#include "renderpool.h"
+#include "stats.h"
+
+// Primary visibility without the accelerator. Camera rays share one origin, so
+// each object's bounds are projected onto the screen and only the pixels they
+// cover are tested against it, like a rasterizer with a depth buffer. Objects
+// go nearest first, so pixels already hit closer are rejected by depth alone,
+// and whole 8x8 tiles when their farthest hit is nearer than the object.
+// The result is the same hit the accelerators would return for each pixel.
+// The screen is split into bins that the render pool rasterizes in parallel,
+// each with the objects whose projection reaches it.
+class VisibilityBuffer {
+public:
+    struct Sample {
+        Intersect intersect;
+        Object* object = nullptr;
+        uint32_t index = std::numeric_limits<uint32_t>::max();
+
+        // While rasterizing: the closest hit so far, finalized into `intersect` at the end
+        Hit hit;
+        const Object* owner = nullptr;
+    };
+
+    VisibilityBuffer(int width, int height, float fov);
+
+    void setCamera(const Camera& camera);
+
+    // Fills every pixel the frame renders with the nearest hit among `objects`,
+    // on the threads of `pool`, counting into `totals`. Pixels with a nonzero
+    // byte in `skip`, when given, are shaded from elsewhere (the reprojection
+    // cache) and left out.
+    void rasterize(const std::vector<Object*>& objects, const Interleave& pixels, const uint8_t* skip,
+                   RenderPool& pool, Stats& totals = stats);
+
+    const glm::vec3& getOrigin() const {
+        return origin;
+    }
+
+    // Direction of the camera ray through the center of pixel (x, y)
+    glm::vec3 getDirection(int x, int y) const;
+
+    const Sample& getSample(int x, int y) const {
+        return samples[y * width + x];
+    }
+
+private:
+    // An object whose projection reaches a bin
+    struct Candidate {
+        float nearest;      // lower bound of its distance to the camera
+        uint32_t index;
+        AABB bounds;
+        glm::ivec2 low;
+        glm::ivec2 high;
+    };
+
+    bool isRasterized(const Interleave& pixels, int x, int y) const {
+        return pixels.isRendered(x, y) && !(skipped && skipped[y * width + x]);
+    }
+
+    // Rasterizes the bin at (binX, binY) with the candidates every chunk found for it
+    void rasterizeBin(int binX, int binY, const std::vector<Object*>& objects, const Interleave& pixels);
+
+    // Pixels whose rays can reach the box, or false when none can
+    bool projectBounds(const AABB& bounds, glm::ivec2& low, glm::ivec2& high) const;
+
+    // Tests one pixel against an object no nearer than `nearest`, true if it became the hit
+    bool testPixel(int x, int y, Object* object, uint32_t index, const AABB& bounds, float nearest);
+
+    // Farthest hit among the rendered pixels of the tile, or max when some has none yet
+    float getTileDepth(int tileX, int tileY, const Interleave& pixels) const;
+
+    int width;
+    int height;
+    float scaleX;
+    float scaleY;
+
+    glm::vec3 origin;
+    glm::vec3 forward;
+    glm::vec3 right;
+    glm::vec3 up;
+
+    const uint8_t* skipped = nullptr;
+
+    std::vector<Ray> rays;
+    std::vector<Sample> samples;
+    int tilesX;
+    std::vector<float> tileDepths;
+
+    int binsX;
+    int binsY;
+    int chunkCount = 0;
+    std::vector<std::vector<Candidate>> bins;   // per chunk of objects, then per bin
+};
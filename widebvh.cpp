@@ -0,0 +1,340 @@
+#include "widebvh.h"
+#include <algorithm>
+#include <cmath>
+#include "stats.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define WIDEBVH_SSE
+#endif
+
+namespace {
+
+// Near and far planes are picked from the direction signs instead of sorting the
+// slab distances, so empty slots (min = +inf, max = -inf) can never be hit.
+struct ChildPlanes {
+    const float* nearX;
+    const float* nearY;
+    const float* nearZ;
+    const float* farX;
+    const float* farY;
+    const float* farZ;
+};
+
+template <int N>
+ChildPlanes childPlanes(const typename WideBVH<N>::Node& node, const Ray& ray) {
+    return {
+            ray.dirIsNeg[0] ? node.maxX : node.minX,
+            ray.dirIsNeg[1] ? node.maxY : node.minY,
+            ray.dirIsNeg[2] ? node.maxZ : node.minZ,
+            ray.dirIsNeg[0] ? node.minX : node.maxX,
+            ray.dirIsNeg[1] ? node.minY : node.maxY,
+            ray.dirIsNeg[2] ? node.minZ : node.maxZ,
+    };
+}
+
+// Same acceptance rule and padding as AABB::rayIntersect
+const float PADDING = 1e-5f;
+
+#ifdef WIDEBVH_SSE
+
+int intersect4(const ChildPlanes& p, int offset, const Ray& ray, float tMax, float* tNear) {
+    const __m128 ox = _mm_set1_ps(ray.origin.x);
+    const __m128 oy = _mm_set1_ps(ray.origin.y);
+    const __m128 oz = _mm_set1_ps(ray.origin.z);
+    const __m128 ix = _mm_set1_ps(ray.invDirection.x);
+    const __m128 iy = _mm_set1_ps(ray.invDirection.y);
+    const __m128 iz = _mm_set1_ps(ray.invDirection.z);
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 padding = _mm_set1_ps(PADDING);
+
+    __m128 t0 = _mm_max_ps(_mm_max_ps(
+            _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(p.nearX + offset), ox), ix),
+            _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(p.nearY + offset), oy), iy)),
+            _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(p.nearZ + offset), oz), iz));
+    __m128 t1 = _mm_min_ps(_mm_min_ps(
+            _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(p.farX + offset), ox), ix),
+            _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(p.farY + offset), oy), iy)),
+            _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(p.farZ + offset), oz), iz));
+
+    t0 = _mm_sub_ps(t0, _mm_mul_ps(_mm_and_ps(t0, absMask), padding));
+    t1 = _mm_add_ps(t1, _mm_mul_ps(_mm_and_ps(t1, absMask), padding));
+
+    __m128 hit = _mm_and_ps(_mm_and_ps(_mm_cmple_ps(t0, t1), _mm_cmpge_ps(t1, _mm_set1_ps(std::max(ray.tMin, 0.0f)))),
+                            _mm_cmple_ps(t0, _mm_set1_ps(tMax)));
+    _mm_storeu_ps(tNear, t0);
+    return _mm_movemask_ps(hit);
+}
+
+#endif
+
+#ifdef __AVX__
+
+int intersect8(const ChildPlanes& p, const Ray& ray, float tMax, float* tNear) {
+    const __m256 ox = _mm256_set1_ps(ray.origin.x);
+    const __m256 oy = _mm256_set1_ps(ray.origin.y);
+    const __m256 oz = _mm256_set1_ps(ray.origin.z);
+    const __m256 ix = _mm256_set1_ps(ray.invDirection.x);
+    const __m256 iy = _mm256_set1_ps(ray.invDirection.y);
+    const __m256 iz = _mm256_set1_ps(ray.invDirection.z);
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    const __m256 padding = _mm256_set1_ps(PADDING);
+
+    __m256 t0 = _mm256_max_ps(_mm256_max_ps(
+            _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(p.nearX), ox), ix),
+            _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(p.nearY), oy), iy)),
+            _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(p.nearZ), oz), iz));
+    __m256 t1 = _mm256_min_ps(_mm256_min_ps(
+            _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(p.farX), ox), ix),
+            _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(p.farY), oy), iy)),
+            _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(p.farZ), oz), iz));
+
+    t0 = _mm256_sub_ps(t0, _mm256_mul_ps(_mm256_and_ps(t0, absMask), padding));
+    t1 = _mm256_add_ps(t1, _mm256_mul_ps(_mm256_and_ps(t1, absMask), padding));
+
+    __m256 hit = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(t0, t1, _CMP_LE_OQ),
+                                             _mm256_cmp_ps(t1, _mm256_set1_ps(std::max(ray.tMin, 0.0f)), _CMP_GE_OQ)),
+                               _mm256_cmp_ps(t0, _mm256_set1_ps(tMax), _CMP_LE_OQ));
+    _mm256_storeu_ps(tNear, t0);
+    return _mm256_movemask_ps(hit);
+}
+
+#endif
+
+// Returns a bit mask of the children the ray reaches between max(ray.tMin, 0) and
+// tMax and writes their entry distances
+template <int N>
+int intersectChildren(const typename WideBVH<N>::Node& node, const Ray& ray, float tMax, float* tNear) {
+    ChildPlanes p = childPlanes<N>(node, ray);
+
+#ifdef __AVX__
+    if constexpr (N == 8) {
+        return intersect8(p, ray, tMax, tNear);
+    }
+#endif
+
+#ifdef WIDEBVH_SSE
+    int mask = 0;
+    for (int offset = 0; offset < N; offset += 4) {
+        mask |= intersect4(p, offset, ray, tMax, tNear + offset) << offset;
+    }
+    return mask;
+#else
+    int mask = 0;
+    for (int i = 0; i < N; i++) {
+        float t0 = std::max(std::max((p.nearX[i] - ray.origin.x) * ray.invDirection.x,
+                                     (p.nearY[i] - ray.origin.y) * ray.invDirection.y),
+                            (p.nearZ[i] - ray.origin.z) * ray.invDirection.z);
+        float t1 = std::min(std::min((p.farX[i] - ray.origin.x) * ray.invDirection.x,
+                                     (p.farY[i] - ray.origin.y) * ray.invDirection.y),
+                            (p.farZ[i] - ray.origin.z) * ray.invDirection.z);
+        t0 -= std::abs(t0) * PADDING;
+        t1 += std::abs(t1) * PADDING;
+        if (t0 <= t1 && t1 >= std::max(ray.tMin, 0.0f) && t0 <= tMax) {
+            mask |= 1 << i;
+        }
+        tNear[i] = t0;
+    }
+    return mask;
+#endif
+}
+
+// Pulls the N binary nodes below `root` up into one wide node, always opening
+// the interior node with the largest surface area next
+template <int N>
+uint32_t collapse(const BVH& binary, uint32_t root, std::vector<typename WideBVH<N>::Node>& nodes) {
+    uint32_t children[N];
+    int childCount = 0;
+
+    const BVH::Node& rootNode = binary.nodes[root];
+    if (rootNode.count > 0) {
+        children[childCount++] = root;
+    } else {
+        children[childCount++] = root + 1;
+        children[childCount++] = rootNode.offset;
+        while (childCount < N) {
+            int best = -1;
+            float bestArea = -1.0f;
+            for (int i = 0; i < childCount; i++) {
+                const BVH::Node& candidate = binary.nodes[children[i]];
+                if (candidate.count == 0 && candidate.bounds.surfaceArea() > bestArea) {
+                    best = i;
+                    bestArea = candidate.bounds.surfaceArea();
+                }
+            }
+            if (best < 0) {
+                break;
+            }
+            uint32_t opened = children[best];
+            children[best] = opened + 1;
+            children[childCount++] = binary.nodes[opened].offset;
+        }
+    }
+
+    uint32_t index = static_cast<uint32_t>(nodes.size());
+    typename WideBVH<N>::Node node;
+    for (int i = 0; i < N; i++) {
+        node.minX[i] = node.minY[i] = node.minZ[i] = std::numeric_limits<float>::infinity();
+        node.maxX[i] = node.maxY[i] = node.maxZ[i] = -std::numeric_limits<float>::infinity();
+        node.child[i] = 0;
+        node.count[i] = 0;
+    }
+    nodes.push_back(node);
+
+    for (int i = 0; i < childCount; i++) {
+        const BVH::Node& child = binary.nodes[children[i]];
+        uint32_t target = child.offset;
+        if (child.count == 0) {
+            target = collapse<N>(binary, children[i], nodes);
+        }
+
+        typename WideBVH<N>::Node& wide = nodes[index];
+        wide.minX[i] = child.bounds.min.x;
+        wide.minY[i] = child.bounds.min.y;
+        wide.minZ[i] = child.bounds.min.z;
+        wide.maxX[i] = child.bounds.max.x;
+        wide.maxY[i] = child.bounds.max.y;
+        wide.maxZ[i] = child.bounds.max.z;
+        wide.child[i] = target;
+        wide.count[i] = child.count;
+    }
+
+    return index;
+}
+
+}
+
+template <int N>
+void WideBVH<N>::build(const std::vector<Object*>& sceneObjects) {
+    objects = sceneObjects;
+    binary.build(objects);
+    nodes.clear();
+    if (binary.nodes.empty()) {
+        return;
+    }
+
+    nodes.reserve(binary.nodes.size() / (N - 1) + 1);
+    collapse<N>(binary, 0, nodes);
+}
+
+template <int N>
+void WideBVH<N>::refit(RenderPool& pool) {
+    if (binary.nodes.empty() || binary.indices.size() != objects.size()) {
+        build(objects);
+        return;
+    }
+
+    // Collapsing is linear in the nodes, as cheap as the refit itself
+    binary.refit(pool);
+    nodes.clear();
+    collapse<N>(binary, 0, nodes);
+}
+
+template <int N>
+size_t WideBVH<N>::getMemoryUsage() const {
+    return nodes.size() * sizeof(Node) + binary.getMemoryUsage();
+}
+
+template <int N>
+Intersect WideBVH<N>::rayIntersect(const Ray& ray, Object*& hitObject, const Object* ignore,
+                                   const Object* ignoreOwner) const {
+    ClosestHit closest{ray, ignore, ignoreOwner};
+    hitObject = nullptr;
+    if (nodes.empty()) {
+        return Intersect{};
+    }
+
+    struct StackEntry {
+        uint32_t child;
+        uint32_t count;
+        float tNear;
+    };
+    StackEntry stack[64 * (N - 1) + 1];
+    int stackSize = 0;
+    stack[stackSize++] = {0, 0, -std::numeric_limits<float>::max()};
+
+    while (stackSize > 0) {
+        StackEntry entry = stack[--stackSize];
+        if (entry.tNear > closest.ray.tMax) {
+            continue;
+        }
+
+        if (entry.count > 0) {
+            binary.store.intersect(entry.child, entry.count, objects, closest);
+            continue;
+        }
+
+        const Node& node = nodes[entry.child];
+        stats.nodeVisits++;
+
+        alignas(32) float tNear[N];
+        int mask = intersectChildren<N>(node, closest.ray, closest.ray.tMax, tNear);
+
+        // Sort the hit children far to near, so the nearest one is popped first
+        int order[N];
+        int hitCount = 0;
+        for (int i = 0; i < N; i++) {
+            if ((mask & (1 << i)) == 0) {
+                continue;
+            }
+            int j = hitCount++;
+            while (j > 0 && tNear[order[j - 1]] < tNear[i]) {
+                order[j] = order[j - 1];
+                j--;
+            }
+            order[j] = i;
+        }
+
+        for (int k = 0; k < hitCount; k++) {
+            int i = order[k];
+            stack[stackSize++] = {node.child[i], node.count[i], tNear[i]};
+        }
+    }
+
+    hitObject = closest.object;
+    return closest.finalize();
+}
+
+template <int N>
+bool WideBVH<N>::occluded(const Ray& ray, const Object*& occluder, const Object* ignore,
+                          const Object* ignoreOwner) const {
+    occluder = nullptr;
+    if (nodes.empty()) {
+        return false;
+    }
+
+    AnyHit anyHit{ray, ignore, ignoreOwner};
+
+    // Any occluder will do, so children are pushed unsorted
+    uint32_t stack[64 * (N - 1) + 1];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0) {
+        const Node& node = nodes[stack[--stackSize]];
+        stats.nodeVisits++;
+
+        alignas(32) float tNear[N];
+        int mask = intersectChildren<N>(node, ray, ray.tMax, tNear);
+        for (int i = 0; i < N; i++) {
+            if ((mask & (1 << i)) == 0) {
+                continue;
+            }
+            if (node.count[i] == 0) {
+                stack[stackSize++] = node.child[i];
+                continue;
+            }
+            for (uint32_t k = node.child[i]; k < node.child[i] + node.count[i]; k++) {
+                if (anyHit.test(objects[binary.indices[k]])) {
+                    occluder = anyHit.occluder;
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+template class WideBVH<4>;
+template class WideBVH<8>;
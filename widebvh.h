@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "glm/glm.hpp"
+#include "accelerator.h"
+#include "bvh.h"
+#include "intersect.h"
+#include "object.h"
+
+// BVH with N = 4 or 8 children per node, obtained by collapsing the binary SAH
+// tree. Child boxes are stored structure-of-arrays so that a single SSE (N = 4)
+// or AVX (N = 8) slab test checks every child of a node at once.
+template <int N>
+class WideBVH : public Accelerator {
+public:
+    struct alignas(32) Node {
+        float minX[N], minY[N], minZ[N];
+        float maxX[N], maxY[N], maxZ[N];
+        uint32_t child[N];  // node index, or first entry in `indices` for leaves
+        uint32_t count[N];  // primitives in a leaf child, 0 for interior or empty slots
+    };
+
+    void build(const std::vector<Object*>& sceneObjects) override;
+
+    // Refits the binary tree, which rebuilds it when it has grown too costly,
+    // and collapses it again
+    void refit(RenderPool& pool) override;
+
+    Intersect rayIntersect(const Ray& ray, Object*& hitObject, const Object* ignore = nullptr,
+                           const Object* ignoreOwner = nullptr) const override;
+
+    bool occluded(const Ray& ray, const Object*& occluder, const Object* ignore = nullptr,
+                  const Object* ignoreOwner = nullptr) const override;
+
+    size_t getMemoryUsage() const override;
+
+    std::string getName() const override {
+        return "bvh" + std::to_string(N);
+    }
+
+    std::vector<Node> nodes;
+
+    // The tree collapsed into `nodes`, kept for refit. The leaves use its
+    // indices and primitive store.
+    BVH binary;
+};
+
+extern template class WideBVH<4>;
+extern template class WideBVH<8>;